@@ -6,39 +6,23 @@
 #include "ABCCube.h"
 #include "utils.h"
 
-/*
- * Static and const member variables. These are maps that make the below functions more readable and maintainable.
-*/
-const std::array<std::string, 19> AbstractCube::moveToStringMap = {
-	"None", "U", "D", "F", "B", "R", "L", "U'", "D'", "F'", "B'", "R'", "L'", "U2", "D2", "F2", "B2", "R2", "L2"
-};
-
-const std::array<AbstractCube::Move, 19> AbstractCube::moveToInverseMap = {
-	Move::None, Move::Ui, Move::Di, Move::Fi, Move::Bi, Move::Ri, Move::Li, Move::U, Move::D, Move::F, Move::B, Move::R, Move::L, Move::U2, Move::D2, Move::F2, Move::B2, Move::R2, Move::L2
-};
-
-const std::unordered_map<std::string, AbstractCube::Move> AbstractCube::stringToMoveMap = {
-	{"None", Move::None}, {"U", Move::U}, {"D", Move::D}, {"F", Move::F}, {"B", Move::B}, {"R", Move::R}, {"L", Move::L},
-	{"U'", Move::Ui}, {"D'", Move::Di}, {"F'", Move::Fi}, {"B'", Move::Bi}, {"R'", Move::Ri}, {"L'", Move::Li},
-	{"U2", Move::U2}, {"D2", Move::D2}, {"F2", Move::F2}, {"B2", Move::B2}, {"R2", Move::R2}, {"L2", Move::L2}
-};
-
-const std::unordered_map<AbstractCube::Move, AbstractCube::RotationFunction> AbstractCube::moveToFunctionMap = 
-{
-	{Move::U, &AbstractCube::rotateU}, {Move::D, &AbstractCube::rotateD}, {Move::F, &AbstractCube::rotateF},
-	{Move::B, &AbstractCube::rotateB}, {Move::R, &AbstractCube::rotateR}, {Move::L, &AbstractCube::rotateL},
-	{Move::Ui, &AbstractCube::rotateUi}, {Move::Di, &AbstractCube::rotateDi}, {Move::Fi, &AbstractCube::rotateFi},
-	{Move::Bi, &AbstractCube::rotateBi}, {Move::Ri, &AbstractCube::rotateRi}, {Move::Li, &AbstractCube::rotateLi},
-	{Move::U2, &AbstractCube::rotateU2}, {Move::D2, &AbstractCube::rotateD2}, {Move::F2, &AbstractCube::rotateF2},
-	{Move::B2, &AbstractCube::rotateB2}, {Move::R2, &AbstractCube::rotateR2}, {Move::L2, &AbstractCube::rotateL2}
-};
+static_assert(AbstractCube::parseMove("R'") == AbstractCube::Move::Ri, "parseMove must read inverse moves");
+static_assert(AbstractCube::parseMove("L2") == AbstractCube::Move::L2, "parseMove must read double moves");
+static_assert(!AbstractCube::parseMove("X") && !AbstractCube::parseMove("R3") && !AbstractCube::parseMove(""), "parseMove must reject unknown moves");
+static_assert(AbstractCube::inverseMove(AbstractCube::inverseMove(AbstractCube::Move::F)) == AbstractCube::Move::F, "Inversion must be an involution");
+static_assert(!AbstractCube::isMoveAllowed(AbstractCube::Move::D, AbstractCube::Move::U2), "U may not follow D");
+static_assert(!AbstractCube::isMoveAllowed(AbstractCube::Move::None, AbstractCube::Move::U2, AbstractCube::Metric::QTM), "Half turns are two moves in QTM");
+static_assert(AbstractCube::isMoveAllowed(AbstractCube::Move::U, AbstractCube::Move::U, AbstractCube::Metric::QTM)
+	&& !AbstractCube::isMoveAllowed(AbstractCube::recordedMove(AbstractCube::Move::U, AbstractCube::Move::U), AbstractCube::Move::U, AbstractCube::Metric::QTM),
+	"QTM allows two equal quarter turns in a row, but not three");
+static_assert(AbstractCube::parseMetric("axial") == AbstractCube::Metric::Axial && !AbstractCube::parseMetric("stm"), "parseMetric must read metric names");
 
 /*
  * Public member functions
 */
 AbstractCube& AbstractCube::rotateInverse(Move move)
 {
-	return (this->*moveToFunctionMap.at(moveToInverseMap[static_cast<int>(move)]) )();
+	return dispatchMove(moveToInverseMap[static_cast<int>(move)]);
 }
 
 AbstractCube& AbstractCube::rotateInverse(const std::vector<Move>& moves)
@@ -51,39 +35,25 @@ AbstractCube& AbstractCube::rotateInverse(const std::vector<Move>& moves)
 
 AbstractCube& AbstractCube::rotateInverse(const std::string& moves)
 {
-	std::vector<std::string> movesVec = split(moves, ' ');
-	// As with before, iterate through the moves in reverse order and apply the inverse of each move
-	for (auto it = movesVec.rbegin(); it != movesVec.rend(); ++it)
-	{
-		if (stringToMoveMap.find(*it) == stringToMoveMap.end())
-			throw std::invalid_argument("Invalid move in sequence: " + *it);
-		rotateInverse(stringToMoveMap.at(*it));
-	}
-	return *this;
+	return rotateInverse(parseMoves(moves));
 }
 
 
 AbstractCube& AbstractCube::applyMoves(Move move)
 {
-	return (this->*moveToFunctionMap.at(move))();
+	return dispatchMove(move);
 }
 
 AbstractCube& AbstractCube::applyMoves(const std::vector<Move>& moves)
 {
 	for (Move move : moves)
-		(this->*moveToFunctionMap.at(move))();
+		dispatchMove(move);
 	return *this;
 }
 
 AbstractCube& AbstractCube::applyMoves(const std::string& moves)
 {
-	std::vector<std::string> movesVec = split(moves, ' ');
-	for (const std::string& move : movesVec)
-	{
-		if (stringToMoveMap.find(move) == stringToMoveMap.end())
-			throw std::invalid_argument("Invalid move in sequence: " + move);
-		(this->*moveToFunctionMap.at(stringToMoveMap.at(move)))();
-	}
+	forEachMove(moves, [this](Move move) { dispatchMove(move); });
 	return *this;
 }
 
@@ -100,8 +70,8 @@ AbstractCube& AbstractCube::clearPrevMove()
 
 std::string AbstractCube::moveToString(Move move)
 {
-	return moveToStringMap[static_cast<int>(move)];
-};
+	return std::string(moveToStringMap[static_cast<uint8_t>(move)]);
+}
 
 std::string AbstractCube::moveToString(const std::vector<Move>& moves)
 {
@@ -137,100 +107,30 @@ std::vector<std::unique_ptr<AbstractCube>> AbstractCube::getNextMoves()
 	 * construct the unique_ptr in place, avoiding (additional) copying.
 	*/
 	std::vector<std::unique_ptr<AbstractCube>> res;
-
-	if (prevMove != Move::U && prevMove != Move::U2 && prevMove != Move::Ui && prevMove != Move::D && prevMove != Move::D2 && prevMove != Move::Di)
-	{
-		auto cubeU = clone();
-		cubeU->rotateU();
-		res.emplace_back(std::move(cubeU));
-
-		auto cubeUi = clone();
-		cubeUi->rotateUi();
-		res.emplace_back(std::move(cubeUi));
-
-		auto cubeU2 = clone();
-		cubeU2->rotateU2();
-		res.emplace_back(std::move(cubeU2));
-	}
-	if (prevMove != Move::D && prevMove != Move::D2 && prevMove != Move::Di)
-	{
-		auto cubeD = clone();
-		cubeD->rotateD();
-		res.emplace_back(std::move(cubeD));
-
-		auto cubeDi = clone();
-		cubeDi->rotateDi();
-		res.emplace_back(std::move(cubeDi));
-
-		auto cubeD2 = clone();
-		cubeD2->rotateD2();
-		res.emplace_back(std::move(cubeD2));
-	}
-	if (prevMove != Move::F && prevMove != Move::F2 && prevMove != Move::Fi && prevMove != Move::B && prevMove != Move::B2 && prevMove != Move::Bi)
-	{
-		auto cubeF = clone();
-		cubeF->rotateF();
-		res.emplace_back(std::move(cubeF));
-
-		auto cubeFi = clone();
-		cubeFi->rotateFi();
-		res.emplace_back(std::move(cubeFi));
-
-		auto cubeF2 = clone();
-		cubeF2->rotateF2();
-		res.emplace_back(std::move(cubeF2));
-	}
-	if (prevMove != Move::B && prevMove != Move::B2 && prevMove != Move::Bi)
+	for (Move move : searchOrder)
 	{
-		auto cubeB = clone();
-		cubeB->rotateB();
-		res.emplace_back(std::move(cubeB));
-
-		auto cubeBi = clone();
-		cubeBi->rotateBi();
-		res.emplace_back(std::move(cubeBi));
-
-		auto cubeB2 = clone();
-		cubeB2->rotateB2();
-		res.emplace_back(std::move(cubeB2));
+		if (!isMoveAllowed(prevMove, move))
+			continue;
+		auto child = clone();
+		child->dispatchMove(move);
+		res.emplace_back(std::move(child));
 	}
-	if (prevMove != Move::R && prevMove != Move::R2 && prevMove != Move::Ri && prevMove != Move::L && prevMove != Move::L2 && prevMove != Move::Li)
-	{
-		auto cubeR = clone();
-		cubeR->rotateR();
-		res.emplace_back(std::move(cubeR));
-
-		auto cubeRi = clone();
-		cubeRi->rotateRi();
-		res.emplace_back(std::move(cubeRi));
-
-		auto cubeR2 = clone();
-		cubeR2->rotateR2();
-		res.emplace_back(std::move(cubeR2));
-	}
-	if (prevMove != Move::L && prevMove != Move::L2 && prevMove != Move::Li)
-	{
-		auto cubeL = clone();
-		cubeL->rotateL();
-		res.emplace_back(std::move(cubeL));
-
-		auto cubeLi = clone();
-		cubeLi->rotateLi();
-		res.emplace_back(std::move(cubeLi));
+	return res;
+}
 
-		auto cubeL2 = clone();
-		cubeL2->rotateL2();
-		res.emplace_back(std::move(cubeL2));
-	}
+std::vector<AbstractCube::Move> AbstractCube::parseMoves(std::string_view moves)
+{
+	std::vector<Move> res;
+	forEachMove(moves, [&res](Move move) { res.push_back(move); });
 	return res;
 }
 
 std::string AbstractCube::getInverse(const std::string& moves) 
 {
-	std::vector<std::string> movesVec = split(moves, ' ');
+	std::vector<Move> movesVec = parseMoves(moves);
 	std::string res;
 	for (auto it = movesVec.rbegin(); it != movesVec.rend(); ++it)
-		res += moveToString(moveToInverseMap[static_cast<int>(stringToMoveMap.at(*it))]) + " ";
+		res += moveToString(inverseMove(*it)) + " ";
 	return trimWhitespace(res);
 }
 
@@ -4,8 +4,12 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
-#include <unordered_map>
 #include <memory>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <optional>
+#include <stdexcept>
 
 #include "utils.h"
 
@@ -27,8 +31,10 @@ public:
 		U2, D2, F2, B2, R2, L2
 	};
 
-	// Typedef for a function pointer to a rotation function
-	typedef AbstractCube& (AbstractCube::* RotationFunction)();
+	// Turn metrics, i.e. what counts as a single move. In the half-turn metric (HTM) every turn of a face is
+	// one move. In the quarter-turn metric (QTM) only quarter turns are moves, so a half turn takes two.
+	// In the axial metric, turning two opposite faces at the same time is also a single move.
+	enum class Metric : uint8_t { HTM, QTM, Axial };
 
 	// Constructor
 	AbstractCube() : prevMove(Move::None) {}
@@ -38,7 +44,8 @@ public:
 	// Note this is not a copy constructor, it is used to create a new instance
 	// of the derived class without knowing the derived class type a priori,
 	// to preserve polymorphism
-	virtual std::unique_ptr<AbstractCube> clone() const = 0; // TODO: figure out how to use templates to avoid having to override this
+	// CubeEngine implements this for every derived class
+	virtual std::unique_ptr<AbstractCube> clone() const = 0;
 
 	// Standard rotations
 	virtual AbstractCube& rotateU() = 0;
@@ -99,10 +106,84 @@ public:
 	// Intelligently filters out inverses/commutative move pairs
 	std::vector<std::unique_ptr<AbstractCube>> getNextMoves();
 
+	// The moves getNextMoves (and the successor buffers of the derived classes) try, in order,
+	// and whether a move may follow the previous move under the filtering rules of getNextMoves.
+	// In QTM the half turns are never allowed, and a quarter turn may follow the same quarter turn
+	// once (see recordedMove), since two of them are the only way to make a half turn.
+	static constexpr std::array<Move, 18> searchOrder = {
+		Move::U, Move::Ui, Move::U2, Move::D, Move::Di, Move::D2, Move::F, Move::Fi, Move::F2,
+		Move::B, Move::Bi, Move::B2, Move::R, Move::Ri, Move::R2, Move::L, Move::Li, Move::L2
+	};
+	static constexpr bool isMoveAllowed(Move prev, Move next, Metric metric = Metric::HTM)
+	{
+		return allowedMoves(prev, metric) & (1u << static_cast<uint8_t>(next));
+	}
+	// All the moves that may follow prev, bit n for the Move with underlying value n
+	static constexpr uint32_t allowedMoves(Move prev, Metric metric = Metric::HTM)
+	{
+		return allowedMovesMaps[static_cast<uint8_t>(metric)][static_cast<uint8_t>(prev)];
+	}
+
+	// The previous move to remember after applying move on top of prev. Two equal quarter turns are
+	// remembered as the half turn they make up, which stops a third one under the QTM rules.
+	// In the other metrics the same face never turns twice in a row, so this is just move.
+	static constexpr Move recordedMove(Move prev, Move move)
+	{
+		uint8_t m = static_cast<uint8_t>(move);
+		if (move != prev || m == 0 || m > 12)
+			return move;
+		return static_cast<Move>(13 + (m - 1) % 6);
+	}
+
+	// Parse a metric name ("htm", "qtm" or "axial"). Returns nothing for an unknown name.
+	static constexpr std::optional<Metric> parseMetric(std::string_view name)
+	{
+		for (uint8_t i = 0; i < metricNames.size(); i++)
+		{
+			if (name == metricNames[i])
+				return static_cast<Metric>(i);
+		}
+		return std::nullopt;
+	}
+	static std::string metricToString(Metric metric) { return std::string(metricNames[static_cast<uint8_t>(metric)]); }
+
+	// Parse a single move in standard notation (e.g. "R", "R'", "R2"). Returns nothing for an invalid move.
+	static constexpr std::optional<Move> parseMove(std::string_view token)
+	{
+		if (token == moveToStringMap[0])
+			return Move::None;
+		if (token.empty() || token.size() > 2)
+			return std::nullopt;
+		// The Move enum lists the 6 faces in the order U, D, F, B, R, L, then the inverses, then the double turns
+		constexpr std::string_view faces = "UDFBRL";
+		size_t face = faces.find(token[0]);
+		if (face == std::string_view::npos)
+			return std::nullopt;
+		if (token.size() == 1)
+			return static_cast<Move>(1 + face);
+		if (token[1] == '\'')
+			return static_cast<Move>(7 + face);
+		if (token[1] == '2')
+			return static_cast<Move>(13 + face);
+		return std::nullopt;
+	}
+
+	// Parse a string of moves separated by spaces, calling visit(move) for every move in order.
+	// The tokens are views into the string, so nothing is allocated. Throws std::invalid_argument
+	// on an invalid move.
+	template <typename Visitor>
+	static void forEachMove(std::string_view moves, Visitor&& visit);
+
+	// Parse a string of moves separated by spaces into a sequence of Moves
+	static std::vector<Move> parseMoves(std::string_view moves);
+
 	// TODO: make cubeHash mandatory for all cubes
 
 	static std::string getInverse(const std::string& moves);
 
+	// The move that undoes the given move (None for None)
+	static constexpr Move inverseMove(Move move) { return moveToInverseMap[static_cast<uint8_t>(move)]; }
+
 
 	// Virtual destructor
 	virtual ~AbstractCube() {}
@@ -113,12 +194,243 @@ protected:
 	// Should only be accessable by the derived classes
 	void setPrevMove(Move move);
 
+	// Apply a single move through the vtable. This is what applyMoves and rotateInverse use;
+	// CubeEngine implements it by calling the derived class directly.
+	virtual AbstractCube& dispatchMove(Move move) = 0;
+
 private:
 	Move prevMove;
-	static const std::array<std::string, 19> moveToStringMap;
-	static const std::array<Move, 19> moveToInverseMap;
-	static const std::unordered_map<std::string, Move> stringToMoveMap;
-	static const std::unordered_map<Move, RotationFunction> moveToFunctionMap;
+
+	/*
+	 * Lookup tables for the functions above. They are all computed at compile time.
+	*/
+	static constexpr std::array<std::string_view, 19> moveToStringMap = {
+		"None", "U", "D", "F", "B", "R", "L", "U'", "D'", "F'", "B'", "R'", "L'", "U2", "D2", "F2", "B2", "R2", "L2"
+	};
+
+	static constexpr std::array<Move, 19> moveToInverseMap = {
+		Move::None, Move::Ui, Move::Di, Move::Fi, Move::Bi, Move::Ri, Move::Li, Move::U, Move::D, Move::F, Move::B, Move::R, Move::L, Move::U2, Move::D2, Move::F2, Move::B2, Move::R2, Move::L2
+	};
+
+	static constexpr std::array<std::string_view, 3> metricNames = { "htm", "qtm", "axial" };
+
+	// Bit n of allowedMovesMaps[metric][prev] is set if the Move with underlying value n may follow prev.
+	// See getNextMoves for the rules. Faces are numbered in enum order: U, D, F, B, R, L,
+	// so that U/D, F/B and R/L are the pairs (0, 1), (2, 3) and (4, 5).
+	//
+	// The axial metric uses the HTM rules. On the 2x2x2 a turn of two opposite faces is a turn of one
+	// of them followed by a whole-cube rotation, so the optimal solutions are the same in both metrics
+	// (and never turn two opposite faces in a row).
+	static constexpr std::array<std::array<uint32_t, 19>, 3> allowedMovesMaps = [] {
+		std::array<std::array<uint32_t, 19>, 3> res{};
+		for (uint8_t metric = 0; metric < 3; metric++)
+		{
+			bool quarterTurns = static_cast<Metric>(metric) == Metric::QTM;
+			for (uint8_t prev = 0; prev < 19; prev++)
+			{
+				for (uint8_t next = 1; next < 19; next++)
+				{
+					uint8_t nextFace = (next - 1) % 6;
+					if (quarterTurns && next > 12)
+						continue;
+					if (prev != 0)
+					{
+						uint8_t prevFace = (prev - 1) % 6;
+						// Optimization 1: no consecutive rotations of the same face, except for the
+						// second quarter turn of a half turn in QTM
+						if (prevFace == nextFace && !(quarterTurns && next == prev))
+							continue;
+						// Optimization 2: U may not follow D, F may not follow B, R may not follow L
+						if (nextFace % 2 == 0 && prevFace == nextFace + 1)
+							continue;
+					}
+					res[metric][prev] |= 1u << next;
+				}
+			}
+		}
+		return res;
+	}();
+};
+
+template <typename Visitor>
+void AbstractCube::forEachMove(std::string_view moves, Visitor&& visit)
+{
+	size_t pos = 0;
+	while (pos < moves.size())
+	{
+		size_t end = moves.find(' ', pos);
+		if (end == std::string_view::npos)
+			end = moves.size();
+		if (end > pos)
+		{
+			std::string_view token = moves.substr(pos, end - pos);
+			std::optional<Move> move = parseMove(token);
+			if (!move)
+				throw std::invalid_argument("Invalid move in sequence: " + std::string(token));
+			visit(*move);
+		}
+		pos = end + 1;
+	}
+}
+
+/* --------------------------------------------------------------------------------------------
+ * A goal for the solvers, tested against the canonical key (cubeHash) of a cube: the cube is at
+ * the goal when the bits of its key selected by mask are equal to key. This makes every goal test
+ * a single compare, whatever the target is. Cube classes provide the goals that make sense for
+ * their key layout (see Cube2Pieces).
+ * --------------------------------------------------------------------------------------------
+*/
+struct CubeGoal
+{
+	uint64_t mask;
+	uint64_t key;
+
+	constexpr bool matches(uint64_t cubeKey) const { return (cubeKey & mask) == key; }
+	constexpr bool operator==(const CubeGoal& other) const { return mask == other.mask && key == other.key; }
+};
+
+/* --------------------------------------------------------------------------------------------
+ * Fixed-capacity buffer for the children of a cube. Derived classes fill it with one entry per
+ * allowed move (at most 18), holding the child state by value together with the move that
+ * produced it. The caller owns the buffer and reuses it across expansions, so generating
+ * successors never touches the heap.
+ * --------------------------------------------------------------------------------------------
+*/
+template <typename CubeType>
+class SuccessorBuffer
+{
+public:
+	struct Successor
+	{
+		CubeType cube;
+		AbstractCube::Move move;
+	};
+
+	static constexpr uint8_t capacity = 18;
+
+	void clear() { count = 0; }
+
+	// Copy the parent into the next free slot. The caller then applies the move to the copy.
+	Successor& push(const CubeType& parent, AbstractCube::Move move)
+	{
+		Successor& successor = successors[count++];
+		successor.cube = parent;
+		successor.move = move;
+		return successor;
+	}
+
+	uint8_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	Successor* begin() { return successors.data(); }
+	Successor* end() { return successors.data() + count; }
+	const Successor* begin() const { return successors.data(); }
+	const Successor* end() const { return successors.data() + count; }
+
+private:
+	std::array<Successor, capacity> successors;
+	uint8_t count = 0;
+};
+
+/* --------------------------------------------------------------------------------------------
+ * CubeEngine is the base that concrete cube classes actually derive from, using the curiously
+ * recurring template pattern: class MyCube : public CubeEngine<MyCube>.
+ *
+ * The derived class provides a single non-virtual function, Derived& turn(Move), that applies
+ * one move and records it as the previous move. CubeEngine builds everything else on top of it:
+ * the 18 virtual rotate functions and clone() of AbstractCube (so existing polymorphic callers
+ * keep working), and statically dispatched applyMoves/getSuccessors. Code that is templated on
+ * the concrete cube type (such as the solvers) only ever calls the latter, so every move can be
+ * inlined instead of going through the vtable.
+ * --------------------------------------------------------------------------------------------
+*/
+template <typename Derived>
+class CubeEngine : public AbstractCube
+{
+public:
+	std::unique_ptr<AbstractCube> clone() const override { return std::make_unique<Derived>(derived()); }
+
+	AbstractCube& rotateU() override { return derived().turn(Move::U); }
+	AbstractCube& rotateD() override { return derived().turn(Move::D); }
+	AbstractCube& rotateR() override { return derived().turn(Move::R); }
+	AbstractCube& rotateL() override { return derived().turn(Move::L); }
+	AbstractCube& rotateF() override { return derived().turn(Move::F); }
+	AbstractCube& rotateB() override { return derived().turn(Move::B); }
+
+	AbstractCube& rotateUi() override { return derived().turn(Move::Ui); }
+	AbstractCube& rotateDi() override { return derived().turn(Move::Di); }
+	AbstractCube& rotateRi() override { return derived().turn(Move::Ri); }
+	AbstractCube& rotateLi() override { return derived().turn(Move::Li); }
+	AbstractCube& rotateFi() override { return derived().turn(Move::Fi); }
+	AbstractCube& rotateBi() override { return derived().turn(Move::Bi); }
+
+	AbstractCube& rotateU2() override { return derived().turn(Move::U2); }
+	AbstractCube& rotateD2() override { return derived().turn(Move::D2); }
+	AbstractCube& rotateR2() override { return derived().turn(Move::R2); }
+	AbstractCube& rotateL2() override { return derived().turn(Move::L2); }
+	AbstractCube& rotateF2() override { return derived().turn(Move::F2); }
+	AbstractCube& rotateB2() override { return derived().turn(Move::B2); }
+
+	// Statically dispatched overloads of the AbstractCube versions
+	Derived& applyMoves(Move move) { return derived().turn(move); }
+	Derived& applyMoves(const std::vector<Move>& moves)
+	{
+		for (Move move : moves)
+			derived().turn(move);
+		return derived();
+	}
+	Derived& applyMoves(const std::string& moves)
+	{
+		forEachMove(moves, [this](Move move) { derived().turn(move); });
+		return derived();
+	}
+
+	// Apply a move in place and undo it exactly, without copying the cube. This lets depth-first
+	// searches walk the whole tree on a single state object. doMove returns the previous move,
+	// which undoMove needs to restore the previous move bookkeeping as well as the state.
+	Move doMove(Move move)
+	{
+		Move prev = getPrevMove();
+		derived().turn(move);
+		setPrevMove(recordedMove(prev, move));
+		return prev;
+	}
+	void undoMove(Move move, Move prev)
+	{
+		derived().turn(inverseMove(move));
+		setPrevMove(prev);
+	}
+
+	// Allocation-free alternative to getNextMoves: writes every allowed child into the buffer,
+	// with the same filtering and order as getNextMoves (for the given metric)
+	void getSuccessors(SuccessorBuffer<Derived>& buffer, Metric metric = Metric::HTM) const
+	{
+		getSuccessors(buffer, allowedMoves(getPrevMove(), metric));
+	}
+
+	// Same, but only for the moves in the mask (bit n for the Move with underlying value n), e.g. the
+	// previous-move rules combined with a MoveAutomaton
+	void getSuccessors(SuccessorBuffer<Derived>& buffer, uint32_t moves) const
+	{
+		buffer.clear();
+		Move prev = getPrevMove();
+		for (Move move : searchOrder)
+		{
+			if (moves & (1u << static_cast<uint8_t>(move)))
+			{
+				Derived& child = buffer.push(derived(), move).cube;
+				child.turn(move);
+				child.setPrevMove(recordedMove(prev, move));
+			}
+		}
+	}
+
+protected:
+	AbstractCube& dispatchMove(Move move) override { return derived().turn(move); }
+
+private:
+	Derived& derived() { return static_cast<Derived&>(*this); }
+	const Derived& derived() const { return static_cast<const Derived&>(*this); }
 };
 
 std::ostream& operator<<(std::ostream& os, const AbstractCube& cube);
@@ -0,0 +1,531 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <array>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <sstream>
+
+#include "Benchmarks.h"
+#include "Cube2Pieces.h"
+#include "CubeBatch.h"
+#include "Cube2Stickers.h"
+#include "utils.h"
+
+// A fixed, pseudo-random sequence of moves so that every variant does the same work
+static std::array<AbstractCube::Move, 1024> makeMoveSequence()
+{
+	std::mt19937 rng(2024);
+	std::array<AbstractCube::Move, 1024> moves{};
+	for (auto& move : moves)
+		move = static_cast<AbstractCube::Move>(1 + rng() % 18);
+	return moves;
+}
+
+// The pre-packing representation of Cube2Pieces: an array of (piece, orientation) structs, turned
+// by copying the corners one by one and reducing every twisted orientation with % 3.
+struct LegacyCorners
+{
+	struct Corner { uint8_t piece; uint8_t orientation; };
+	std::array<Corner, 8> corners;
+
+	void turn(const std::array<uint8_t, 8>& source, const std::array<uint8_t, 8>& twist)
+	{
+		std::array<Corner, 8> old = corners;
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			corners[i] = old[source[i]];
+			corners[i].orientation = (corners[i].orientation + twist[i]) % 3;
+		}
+	}
+};
+
+// Depth-first walk of the search tree that expands every node by cloning the parent
+static uint64_t walkByCloning(AbstractCube& cube, int depth)
+{
+	if (depth == 0)
+		return 1;
+	uint64_t nodes = 1;
+	for (auto& child : cube.getNextMoves())
+		nodes += walkByCloning(*child, depth - 1);
+	return nodes;
+}
+
+// The same walk on a single state object, applying each move in place and undoing it afterwards
+static uint64_t walkInPlace(Cube2Pieces& cube, int depth)
+{
+	if (depth == 0)
+		return 1;
+	uint64_t nodes = 1;
+	for (AbstractCube::Move move : AbstractCube::searchOrder)
+	{
+		if (!AbstractCube::isMoveAllowed(cube.getPrevMove(), move))
+			continue;
+		AbstractCube::Move prev = cube.doMove(move);
+		nodes += walkInPlace(cube, depth - 1);
+		cube.undoMove(move, prev);
+	}
+	return nodes;
+}
+
+void MicroBenchmark::run(uint64_t iterations)
+{
+	benchMoveKernels(iterations);
+	benchTreeWalk(iterations);
+	benchScrambles(iterations);
+	benchSerialization(iterations);
+	benchBatch(iterations);
+	benchStickers(iterations);
+}
+
+void MicroBenchmark::benchMoveKernels(uint64_t iterations)
+{
+	const auto moves = makeMoveSequence();
+	const uint64_t operations = iterations * moves.size();
+	std::cout << "Move application (" << operations << " moves per variant)" << std::endl;
+
+	// Legacy struct-array turns
+	{
+		std::array<std::array<uint8_t, 8>, 19> twists{};
+		for (uint8_t m = 0; m < 19; m++)
+			for (uint8_t i = 0; i < 8; i++)
+				twists[m][i] = (Cube2Pieces::moveTables[m].twist >> (i * 8)) & 0xFF;
+
+		LegacyCorners cube{};
+		for (uint8_t i = 0; i < 8; i++)
+			cube.corners[i] = { i, 0 };
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				cube.turn(Cube2Pieces::moveTables[static_cast<uint8_t>(move)].source, twists[static_cast<uint8_t>(move)]);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		uint64_t checksum = 0;
+		for (const auto& corner : cube.corners)
+			checksum = checksum * 31 + corner.piece * 3 + corner.orientation;
+		report("legacy struct array", elapsed.count(), operations, checksum);
+	}
+
+	// Packed word, scalar kernel
+	{
+		uint64_t state = Cube2Pieces().state;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				state = Cube2Pieces::applyTransformScalar(state, Cube2Pieces::moveTables[static_cast<uint8_t>(move)]);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("packed scalar", elapsed.count(), operations, state);
+	}
+
+#if defined(__SSSE3__)
+	// Packed word, SSSE3 byte shuffle kernel
+	{
+		uint64_t state = Cube2Pieces().state;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				state = Cube2Pieces::applyTransformSimd(state, Cube2Pieces::moveTables[static_cast<uint8_t>(move)]);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("packed SSSE3 shuffle", elapsed.count(), operations, state);
+	}
+#else
+	std::cout << "  packed SSSE3 shuffle: not available for this target" << std::endl;
+#endif
+
+	// Through the public API with static dispatch, including the previous move bookkeeping
+	{
+		Cube2Pieces cube;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				cube.applyMoves(move);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("Cube2Pieces::applyMoves", elapsed.count(), operations, cube.state);
+	}
+
+	// Through the polymorphic AbstractCube interface, one virtual call per move
+	{
+		Cube2Pieces cube;
+		AbstractCube& abstractCube = cube;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				abstractCube.applyMoves(move);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("AbstractCube::applyMoves", elapsed.count(), operations, cube.state);
+	}
+	std::cout << std::endl;
+}
+
+void MicroBenchmark::benchTreeWalk(uint64_t iterations)
+{
+	// Every walk visits the same ~370K nodes, so scale the number of walks down
+	const int depth = 5;
+	const uint64_t walks = std::max<uint64_t>(1, iterations / 1000);
+	std::cout << "Depth " << depth << " tree walk (" << walks << " walks per variant)" << std::endl;
+
+	{
+		Cube2Pieces cube;
+		uint64_t nodes = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < walks; it++)
+			nodes += walkByCloning(cube, depth);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("clone per child", elapsed.count(), nodes, nodes);
+	}
+
+	{
+		Cube2Pieces cube;
+		uint64_t nodes = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < walks; it++)
+			nodes += walkInPlace(cube, depth);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		// The walk must leave the cube exactly as it found it
+		if (cube.state != Cube2Pieces().state || cube.getPrevMove() != AbstractCube::Move::None)
+			throw std::runtime_error("Error: in-place tree walk did not restore the cube.");
+		report("in-place do/undo", elapsed.count(), nodes, nodes);
+	}
+	std::cout << std::endl;
+}
+
+void MicroBenchmark::benchScrambles(uint64_t iterations)
+{
+	// 15-move scrambles, as in the benchmark mode
+	const auto sequence = makeMoveSequence();
+	const size_t scrambleLength = 15;
+	std::vector<std::string> scrambles;
+	for (size_t i = 0; i + scrambleLength <= sequence.size(); i += scrambleLength)
+		scrambles.push_back(AbstractCube::moveToString(std::vector<AbstractCube::Move>(sequence.begin() + i, sequence.begin() + i + scrambleLength)));
+	const uint64_t rounds = std::max<uint64_t>(1, iterations / 10);
+	const uint64_t operations = rounds * scrambles.size();
+	std::cout << "Scramble setup (" << operations << " scrambles of " << scrambleLength << " moves per variant)" << std::endl;
+
+	// What applyMoves(string) used to do: split into strings, then look up and apply every move
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			for (const std::string& scramble : scrambles)
+			{
+				Cube2Pieces cube;
+				for (const std::string& token : split(scramble, ' '))
+					cube.applyMoves(*AbstractCube::parseMove(token));
+				checksum += cube.state;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("split and apply", elapsed.count(), operations, checksum);
+	}
+
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			for (const std::string& scramble : scrambles)
+			{
+				Cube2Pieces cube(scramble);
+				checksum += cube.state;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("Cube2Pieces(string)", elapsed.count(), operations, checksum);
+	}
+
+	// Compile once, then apply the composite transform
+	{
+		std::vector<Cube2Pieces::CompiledScramble> compiled;
+		for (const std::string& scramble : scrambles)
+			compiled.emplace_back(scramble);
+
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			for (const auto& scramble : compiled)
+			{
+				Cube2Pieces cube;
+				cube.applyScramble(scramble);
+				checksum += cube.state;
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("applyScramble (compiled)", elapsed.count(), operations, checksum);
+	}
+
+	// Build the same states from their stickers, in one batch call per round
+	{
+		std::string facelets;
+		for (const std::string& scramble : scrambles)
+			facelets += Cube2Pieces(scramble).toFacelets();
+		std::vector<Cube2Pieces> cubes(scrambles.size());
+		std::vector<Cube2Pieces::FaceletStatus> status(scrambles.size());
+
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			if (Cube2Pieces::fromFacelets(facelets.data(), cubes.size(), cubes.data(), status.data()) != cubes.size())
+				throw std::runtime_error("Error: facelet benchmark produced an invalid state.");
+			for (const Cube2Pieces& cube : cubes)
+				checksum += cube.state;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("fromFacelets (batch)", elapsed.count(), operations, checksum);
+	}
+	std::cout << std::endl;
+}
+
+void MicroBenchmark::benchSerialization(uint64_t iterations)
+{
+	// The states reached along the fixed move sequence, written and read back in one batch per round
+	const auto sequence = makeMoveSequence();
+	std::vector<Cube2Pieces> cubes;
+	Cube2Pieces cube;
+	for (AbstractCube::Move move : sequence)
+		cubes.push_back(cube.applyMoves(move));
+	const uint64_t rounds = std::max<uint64_t>(1, iterations / 10);
+	const uint64_t operations = rounds * cubes.size();
+	std::cout << "Serialization (" << operations << " states per variant)" << std::endl;
+
+	// Through toString and a string stream, as the pipelines used to
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds / 10 + 1; it++)
+		{
+			std::stringstream stream;
+			for (const Cube2Pieces& c : cubes)
+				stream << c.toString();
+			checksum += stream.str().size();
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("toString to stream", elapsed.count(), (rounds / 10 + 1) * cubes.size(), checksum);
+	}
+
+	std::vector<uint8_t> bytes(cubes.size() * Cube2Pieces::packedSize);
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			Cube2Pieces::serialize(cubes.data(), cubes.size(), bytes.data());
+			checksum += bytes[it % bytes.size()];
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("serialize (5 bytes)", elapsed.count(), operations, checksum);
+	}
+
+	std::vector<Cube2Pieces> decoded(cubes.size());
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			Cube2Pieces::deserialize(bytes.data(), bytes.size() / Cube2Pieces::packedSize, decoded.data());
+			checksum += decoded[it % decoded.size()].state;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (!std::equal(cubes.begin(), cubes.end(), decoded.begin()))
+			throw std::runtime_error("Error: serialization benchmark did not round trip.");
+		report("deserialize (5 bytes)", elapsed.count(), operations, checksum);
+	}
+
+	std::vector<uint32_t> indices(cubes.size());
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			Cube2Pieces::serializeIndices(cubes.data(), cubes.size(), indices.data());
+			checksum += indices[it % indices.size()];
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("serializeIndices (32 bits)", elapsed.count(), operations, checksum);
+	}
+
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			Cube2Pieces::deserializeIndices(indices.data(), indices.size(), decoded.data());
+			checksum += decoded[it % decoded.size()].state;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("deserializeIndices", elapsed.count(), operations, checksum);
+	}
+	std::cout << std::endl;
+}
+
+void MicroBenchmark::benchBatch(uint64_t iterations)
+{
+	// A batch of cubes scrambled by the fixed move sequence, moved and hashed one cube at a time and all at once
+	const auto sequence = makeMoveSequence();
+	std::vector<Cube2Pieces> cubes;
+	Cube2Pieces cube;
+	for (AbstractCube::Move move : sequence)
+		cubes.push_back(cube.applyMoves(move));
+	const uint64_t rounds = std::max<uint64_t>(1, iterations / 10);
+	const uint64_t operations = rounds * cubes.size();
+	std::cout << "Batch moves and hashes (" << operations << " cubes per variant)" << std::endl;
+
+	// One cube at a time through the public API
+	{
+		std::vector<Cube2Pieces> copies = cubes;
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			AbstractCube::Move move = sequence[it % sequence.size()];
+			for (Cube2Pieces& c : copies)
+				checksum += c.turn(move).cubeHash();
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("turn + cubeHash per cube", elapsed.count(), operations, checksum);
+	}
+
+	// The same moves applied to the whole batch, then one bulk hash
+	{
+		CubeBatch batch(cubes.data(), cubes.size());
+		std::vector<uint64_t> keys(batch.size());
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+		{
+			batch.applyMove(sequence[it % sequence.size()]);
+			batch.hashes(keys.data());
+			for (uint64_t key : keys)
+				checksum += key;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("CubeBatch applyMove + hashes", elapsed.count(), operations, checksum);
+	}
+	std::cout << std::endl;
+}
+
+// Order-dependent checksum of the 24 stickers, for the sticker variants
+static uint64_t stickerChecksum(const std::array<uint8_t, 32>& stickers)
+{
+	uint64_t checksum = 0;
+	for (uint8_t f = 0; f < 24; f++)
+		checksum = checksum * 7 + stickers[f];
+	return checksum;
+}
+
+void MicroBenchmark::benchStickers(uint64_t iterations)
+{
+	const auto moves = makeMoveSequence();
+	const uint64_t operations = iterations * moves.size();
+	std::cout << "Sticker moves (" << operations << " moves per variant)" << std::endl;
+
+	{
+		Cube2Stickers cube;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				cube.permuteScalar(move);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("stickers scalar", elapsed.count(), operations, stickerChecksum(cube.stickers));
+	}
+
+#if defined(__SSSE3__)
+	{
+		Cube2Stickers cube;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				cube.permuteSsse3(move);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("stickers SSSE3 half shuffles", elapsed.count(), operations, stickerChecksum(cube.stickers));
+	}
+#else
+	std::cout << "  stickers SSSE3 half shuffles: not available for this target" << std::endl;
+#endif
+
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+	{
+		Cube2Stickers cube;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < iterations; it++)
+			for (auto move : moves)
+				cube.permuteVbmi(move);
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("stickers VBMI vpermb", elapsed.count(), operations, stickerChecksum(cube.stickers));
+	}
+#else
+	std::cout << "  stickers VBMI vpermb: not available for this target" << std::endl;
+#endif
+	std::cout << std::endl;
+
+	/*
+	 * Facelet workloads on the states along the move sequence. "turn + render" writes the facelets after every
+	 * move, as a display would. "parse/turn/render" also starts every state from its facelets, as a vision
+	 * front end would, which includes validating them.
+	 */
+	const uint64_t rounds = std::max<uint64_t>(1, iterations / 10);
+	const uint64_t states = rounds * moves.size();
+	std::vector<std::string> facelets;
+	Cube2Pieces scrambled;
+	for (auto move : moves)
+		facelets.push_back(scrambled.turn(move).toFacelets());
+	std::cout << "Facelet workloads (" << states << " states per variant)" << std::endl;
+
+	{
+		Cube2Pieces cube;
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+			for (auto move : moves)
+				checksum += cube.turn(move).toFacelets()[it % 24];
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("turn + render, pieces", elapsed.count(), states, checksum);
+	}
+
+	{
+		Cube2Stickers cube;
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+			for (auto move : moves)
+				checksum += cube.turn(move).toFacelets()[it % 24];
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("turn + render, stickers", elapsed.count(), states, checksum);
+	}
+
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+			for (size_t i = 0; i < moves.size(); i++)
+				checksum += Cube2Pieces::fromFacelets(facelets[i]).turn(moves[i]).toFacelets()[it % 24];
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("parse/turn/render, pieces", elapsed.count(), states, checksum);
+	}
+
+	{
+		uint64_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint64_t it = 0; it < rounds; it++)
+			for (size_t i = 0; i < moves.size(); i++)
+				checksum += Cube2Stickers::fromFacelets(facelets[i]).turn(moves[i]).toFacelets()[it % 24];
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		report("parse/turn/render, stickers", elapsed.count(), states, checksum);
+	}
+	std::cout << std::endl;
+}
+
+void MicroBenchmark::report(const std::string& name, double seconds, uint64_t operations, uint64_t checksum)
+{
+	// The checksum is printed so that the compiler cannot drop the benchmarked work,
+	// and so that variants that should agree can be compared at a glance
+	std::cout << "  " << std::left << std::setw(28) << name << std::right
+		<< std::fixed << std::setprecision(3) << std::setw(9) << seconds * 1e9 / operations << " ns/op"
+		<< "  (checksum " << std::hex << checksum << std::dec << ")" << std::endl;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* ----------------------------------------------------------------------------
+ * This file contains microbenchmarks for the innermost operations of the
+ * solvers. Unlike the 'benchmark' mode, which times whole solves, these time
+ * a single operation (e.g. applying a move) in a tight loop, and compare the
+ * implementations we have for it against each other.
+ *
+ * They are run with the 'microbench' mode of the CLI. Every benchmark prints
+ * the average time per operation in nanoseconds.
+ * --------------------------------------------------------------------------
+*/
+
+class MicroBenchmark
+{
+public:
+	static void run(uint64_t iterations);
+
+private:
+	static void benchMoveKernels(uint64_t iterations);
+	static void benchTreeWalk(uint64_t iterations);
+	static void benchScrambles(uint64_t iterations);
+	static void benchSerialization(uint64_t iterations);
+	static void benchBatch(uint64_t iterations);
+	static void benchStickers(uint64_t iterations);
+
+	static void report(const std::string& name, double seconds, uint64_t operations, uint64_t checksum);
+};
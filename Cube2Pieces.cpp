@@ -3,6 +3,8 @@
 #include <sstream>
 #include <memory>
 #include <cstdint>
+#include <stdexcept>
+#include <string_view>
 
 #include "Cube2Pieces.h"
 
@@ -20,323 +22,533 @@ const std::array<std::string, 8> Cube2Pieces::pieceToStringMap = {
  * Public member functions
 */
 
-Cube2Pieces::Cube2Pieces() : AbstractCube()
+Cube2Pieces::Cube2Pieces() : CubeEngine()
 {
 	// Initialize the cube to a solved state
+	anchor = 0;
+	canonicalKey = invalidKey;
+	state = 0;
 	for (uint8_t i = 0; i < 8; i++)
-	{
-		corners[i].piece = static_cast<Piece>(i);
-		corners[i].orientation = 0;
-	}
+		state |= static_cast<uint64_t>(i) << (i * 8 + 4);
+}
+
+Cube2Pieces::CompiledScramble::CompiledScramble(std::string_view moves)
+	: transform(moveTables[static_cast<uint8_t>(Move::None)])
+{
+	forEachMove(moves, [this](Move move) {
+		this->moves.push_back(move);
+		transform = Cube2Tables::composeTransforms(transform, moveTables[static_cast<uint8_t>(move)]);
+	});
 }
 
-Cube2Pieces::Cube2Pieces(const Cube2Pieces& other) : AbstractCube()
+Cube2Pieces& Cube2Pieces::applyScramble(const CompiledScramble& scramble)
 {
+	state = applyTransform(state, scramble.transform);
+	anchor = Cube2Tables::transformAnchor(scramble.transform, anchor);
+	canonicalKey = invalidKey;
+	if (!scramble.moves.empty())
+		setPrevMove(scramble.moves.back());
+	return *this;
+}
+
+std::string Cube2Pieces::toString() const
+{
+	std::stringstream ss;
 	for (uint8_t i = 0; i < 8; i++)
 	{
-		corners[i].piece = other.corners[i].piece;
-		corners[i].orientation = other.corners[i].orientation;
+		ss << positionToStringMap[i] << ": ";
+		ss << pieceToStringMap[static_cast<uint8_t>(pieceAt(i))] << " ";
+		ss << static_cast<int>(orientationAt(i)) << std::endl;
 	}
-	setPrevMove(other.getPrevMove());
+	return ss.str();
 }
 
-std::unique_ptr<AbstractCube> Cube2Pieces::clone() const
+uint64_t Cube2Pieces::computeCanonicalKey() const
 {
-	return std::make_unique<Cube2Pieces>(*this);
+	return canonicalKeyOf(state, anchor);
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateU()
+uint64_t Cube2Pieces::canonicalKeyOf(uint64_t state, uint8_t anchor)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = tmp;
-	// Note that the orientation of the pieces does not change in U/D moves.
-	setPrevMove(Move::U);
-	return *this;
+	// Normalize a copy of the state; the whole-cube rotation does not change the canonical key.
+	// Anchor 0 is already normalized, which is always the case in the fixed-corner searches.
+	uint64_t normalized = anchor == 0 ? state : applyTransform(state, normalizationTables[anchor]);
+	uint64_t key = 0;
+	// Since pieces are in the range 0-7, each of the pieces understood as integers can be represented in 3 bits.
+	// And we have 8 pieces, so we need 24 bits to represent the permutation of the pieces.
+	// Similarly, we only need 2 bits to represent the orientation of a piece, so 16 bits for all 8.
+#if defined(__BMI2__)
+	// Extract the 3 piece bits and the 2 orientation bits of every byte in one instruction each
+	key = _pext_u64(normalized, 0x7070707070707070ULL) | (_pext_u64(normalized, 0x0303030303030303ULL) << 24);
+#else
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint64_t corner = (normalized >> (i * 8)) & 0xFF;
+		key |= (corner >> 4) << (i * 3);
+		key |= (corner & 0x3) << (24 + i * 2);
+	}
+#endif
+	return key;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateD()
+void Cube2Pieces::getFixedCornerSuccessors(SuccessorBuffer<Cube2Pieces>& buffer, Metric metric) const
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = tmp;
-	// Note that the orientation of the pieces does not change in U/D moves.
-	setPrevMove(Move::D);
-	return *this;
+	buffer.clear();
+	Move prev = getPrevMove();
+	for (Move move : fixedCornerMoves)
+	{
+		if (isMoveAllowed(prev, move, metric))
+		{
+			Cube2Pieces& child = buffer.push(*this, move).cube;
+			child.turn(move);
+			child.setPrevMove(recordedMove(prev, move));
+		}
+	}
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateR()
+uint64_t Cube2Pieces::symmetryHash() const
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = tmp;
-
-	updateCornerOrientation(Position::URF, 1);
-	updateCornerOrientation(Position::DRF, 2);
-	updateCornerOrientation(Position::DRB, 1);
-	updateCornerOrientation(Position::URB, 2);
-
-	setPrevMove(Move::R);
-	return *this;
+	Symmetry symmetry;
+	return findSymmetryRepresentative(symmetry).second;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateL()
+Cube2Pieces Cube2Pieces::symmetryRepresentative(Symmetry& symmetry) const
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = tmp;
-
-	updateCornerOrientation(Position::ULF, 2);
-	updateCornerOrientation(Position::ULB, 1);
-	updateCornerOrientation(Position::DLB, 2);
-	updateCornerOrientation(Position::DLF, 1);
-
-	setPrevMove(Move::L);
-	return *this;
+	Cube2Pieces res;
+	res.state = findSymmetryRepresentative(symmetry).first;
+	return res;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateF()
+AbstractCube::Move Cube2Pieces::mapSymmetricMove(const Symmetry& symmetry, Move move)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = tmp;
+	Move res = conjugationTables[symmetry.anchor][static_cast<uint8_t>(move)];
+	return symmetry.mirrored ? mirrorMoves[static_cast<uint8_t>(res)] : res;
+}
 
-	updateCornerOrientation(Position::URF, 2);
-	updateCornerOrientation(Position::ULF, 1);
-	updateCornerOrientation(Position::DLF, 2);
-	updateCornerOrientation(Position::DRF, 1);
+Cube2Pieces Cube2Pieces::inverse() const
+{
+	Cube2Pieces res;
+	res.state = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint8_t piece = static_cast<uint8_t>(pieceAt(i));
+		uint8_t ori = (3 - orientationAt(i)) % 3;
+		res.state |= ((static_cast<uint64_t>(i) << 4) | ori) << (piece * 8);
+	}
+	res.anchor = findAnchor(res.state);
+	return res;
+}
 
-	setPrevMove(Move::F);
-	return *this;
+Cube2Pieces Cube2Pieces::mirrored() const
+{
+	Cube2Pieces res;
+	res.state = mirrorState(state);
+	res.anchor = findAnchor(res.state);
+	return res;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateB()
+std::pair<uint64_t, uint64_t> Cube2Pieces::findSymmetryRepresentative(Symmetry& symmetry) const
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = tmp;
+	/*
+	 * Recoloring a cube by a whole-cube rotation (relabeling every piece as the piece the rotation moves it to)
+	 * gives a cube that the same moves solve, since they take it to a rotated solved cube. Mirroring gives a cube
+	 * that the mirrored moves solve. So we try both mirror images under all 24 recolorings, normalize each, and
+	 * keep the one with the smallest key. Only the anchor before normalizing and the mirror flag are needed to
+	 * map moves back, because the recoloring does not change the moves.
+	 */
+	uint64_t bestState = 0;
+	uint64_t bestKey = invalidKey;
+	for (bool mirror : { false, true })
+	{
+		uint64_t base = mirror ? mirrorState(state) : state;
+		for (uint64_t recolorTable : recolorTables)
+		{
+			uint64_t image = recolor(base, recolorTable);
+			uint8_t imageAnchor = findAnchor(image);
+			uint64_t key = canonicalKeyOf(image, imageAnchor);
+			if (key < bestKey)
+			{
+				bestKey = key;
+				bestState = applyTransform(image, normalizationTables[imageAnchor]);
+				symmetry = { imageAnchor, mirror };
+			}
+		}
+	}
+	return { bestState, bestKey };
+}
 
-	updateCornerOrientation(Position::URB, 1);
-	updateCornerOrientation(Position::DRB, 2);
-	updateCornerOrientation(Position::DLB, 1);
-	updateCornerOrientation(Position::ULB, 2);
+uint64_t Cube2Pieces::recolor(uint64_t state, uint64_t recolorTable)
+{
+	// Look up the new piece and twist of every piece, then add the old orientations and reduce them mod 3
+#if defined(__SSSE3__)
+	const __m128i mod3 = _mm_setr_epi8(0, 1, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i lowNibble = _mm_set1_epi8(0x0F);
 
-	setPrevMove(Move::B);
-	return *this;
+	__m128i corners = _mm_cvtsi64_si128(static_cast<int64_t>(state));
+	__m128i pieces = _mm_and_si128(_mm_srli_epi16(corners, 4), _mm_set1_epi8(0x07));
+	__m128i res = _mm_shuffle_epi8(_mm_cvtsi64_si128(static_cast<int64_t>(recolorTable)), pieces);
+	res = _mm_add_epi8(res, _mm_and_si128(corners, _mm_set1_epi8(0x03)));
+	__m128i orientations = _mm_shuffle_epi8(mod3, _mm_and_si128(res, lowNibble));
+	res = _mm_or_si128(_mm_andnot_si128(lowNibble, res), orientations);
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(res));
+#else
+	uint64_t res = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint8_t piece = (state >> (i * 8 + 4)) & 0x7;
+		uint8_t ori = (state >> (i * 8)) & 0x3;
+		res |= (((recolorTable >> (piece * 8)) & 0xFF) + ori) << (i * 8);
+	}
+	uint64_t overflow = ((res >> 2) | (res & (res >> 1))) & 0x0101010101010101ULL;
+	return res - overflow * 3;
+#endif
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateUi()
+uint64_t Cube2Pieces::mirrorState(uint64_t state)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = tmp;
-	// Note that the orientation of the pieces does not change in U/D moves.
-	setPrevMove(Move::Ui);
-	return *this;
+	uint64_t res = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint64_t corner = (state >> (Cube2Tables::mirrorPosition(i) * 8)) & 0xFF;
+		uint8_t piece = Cube2Tables::mirrorPosition(corner >> 4);
+		uint8_t ori = (3 - (corner & 0x3)) % 3;
+		res |= ((static_cast<uint64_t>(piece) << 4) | ori) << (i * 8);
+	}
+	return res;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateDi()
+uint8_t Cube2Pieces::findAnchor(uint64_t state)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = tmp;
-	// Note that the orientation of the pieces does not change in U/D moves.
-	setPrevMove(Move::Di);
-	return *this;
+	// WRB is the only byte whose piece bits are all zero
+	uint64_t pieceBits = state & 0x7070707070707070ULL;
+	uint64_t zeroBytes = (pieceBits - 0x0101010101010101ULL) & ~pieceBits & 0x8080808080808080ULL;
+	if (zeroBytes == 0)
+		throw std::logic_error("Error: cube state without a WRB corner.");
+	uint8_t pos = __builtin_ctzll(zeroBytes) / 8;
+	return pos * 3 + ((state >> (pos * 8)) & 0x3);
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateRi()
+template <bool writeColors>
+Cube2Pieces::FaceletStatus Cube2Pieces::parseFacelets(const char* facelets, uint64_t& state, uint8_t* colors)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = tmp;
+	state = 0;
+	uint8_t seenPieces = 0;
+	uint8_t twist = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		const auto& stickers = Cube2Tables::cornerFacelets[i];
+		uint8_t c0 = colorIndex[static_cast<uint8_t>(facelets[stickers[0]])];
+		uint8_t c1 = colorIndex[static_cast<uint8_t>(facelets[stickers[1]])];
+		uint8_t c2 = colorIndex[static_cast<uint8_t>(facelets[stickers[2]])];
+		if ((c0 | c1 | c2) == 0xFF)
+			return FaceletStatus::BadColor;
+		if constexpr (writeColors)
+		{
+			colors[stickers[0]] = c0;
+			colors[stickers[1]] = c1;
+			colors[stickers[2]] = c2;
+		}
+
+		uint8_t corner = cornerColors[c0 * 36 + c1 * 6 + c2];
+		if (corner == 0xFF)
+			return FaceletStatus::BadCorner;
+		uint8_t pieceBit = 1 << (corner >> 4);
+		if (seenPieces & pieceBit)
+			return FaceletStatus::DuplicatePiece;
+		seenPieces |= pieceBit;
+		twist += corner & 0x3;
+		state |= static_cast<uint64_t>(corner) << (i * 8);
+	}
+	// With 8 distinct pieces every piece is present; the twists of a reachable state add up to a multiple of 3
+	if (twist % 3 != 0)
+		return FaceletStatus::BadTwist;
+	return FaceletStatus::Valid;
+}
 
-	updateCornerOrientation(Position::URF, 1);
-	updateCornerOrientation(Position::URB, 2);
-	updateCornerOrientation(Position::DRB, 1);
-	updateCornerOrientation(Position::DRF, 2);
+void Cube2Pieces::parseFaceletsOrThrow(std::string_view facelets, uint64_t& state, uint8_t* colors)
+{
+	static const std::array<std::string, 6> messages = {
+		"", "Error: a facelet string must have 24 characters.", "Error: facelet string with a character that is not one of WBRYGO.",
+		"Error: facelet string with stickers that do not form a corner.", "Error: facelet string with a corner that appears twice.",
+		"Error: facelet string with a twisted corner (the twists do not add up to a multiple of 3)."
+	};
 
-	setPrevMove(Move::Ri);
-	return *this;
+	FaceletStatus status = FaceletStatus::BadLength;
+	if (facelets.size() == 24)
+		status = colors != nullptr ? parseFacelets<true>(facelets.data(), state, colors) : parseFacelets<false>(facelets.data(), state, nullptr);
+	if (status != FaceletStatus::Valid)
+		throw std::invalid_argument(messages[static_cast<uint8_t>(status)]);
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateLi()
+Cube2Pieces Cube2Pieces::fromFacelets(std::string_view facelets)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = tmp;
-
-	updateCornerOrientation(Position::ULF, 2);
-	updateCornerOrientation(Position::DLF, 1);
-	updateCornerOrientation(Position::DLB, 2);
-	updateCornerOrientation(Position::ULB, 1);
+	Cube2Pieces res;
+	parseFaceletsOrThrow(facelets, res.state);
+	res.anchor = findAnchor(res.state);
+	return res;
+}
 
-	setPrevMove(Move::Li);
-	return *this;
+size_t Cube2Pieces::fromFacelets(const char* facelets, size_t count, Cube2Pieces* out, FaceletStatus* status)
+{
+	size_t valid = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t state;
+		status[i] = parseFacelets<false>(facelets + i * 24, state, nullptr);
+		out[i] = Cube2Pieces();
+		if (status[i] == FaceletStatus::Valid)
+		{
+			out[i].state = state;
+			out[i].anchor = findAnchor(state);
+			valid++;
+		}
+	}
+	return valid;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateFi()
+std::string Cube2Pieces::toFacelets() const
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URF)];
-	corners[static_cast<uint8_t>(Position::URF)] = corners[static_cast<uint8_t>(Position::DRF)];
-	corners[static_cast<uint8_t>(Position::DRF)] = corners[static_cast<uint8_t>(Position::DLF)];
-	corners[static_cast<uint8_t>(Position::DLF)] = corners[static_cast<uint8_t>(Position::ULF)];
-	corners[static_cast<uint8_t>(Position::ULF)] = tmp;
+	std::string res(24, ' ');
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		// The stickers of the piece, in its own (solved) position, give its colors in clockwise order
+		uint8_t piece = static_cast<uint8_t>(pieceAt(i));
+		uint8_t k = (3 - orientationAt(i)) % 3;
+		for (uint8_t j = 0; j < 3; j++)
+			res[Cube2Tables::cornerFacelets[i][(k + j) % 3]] = Cube2Tables::faceColors[Cube2Tables::cornerFacelets[piece][j] / 4];
+	}
+	return res;
+}
 
-	updateCornerOrientation(Position::URF, 2);
-	updateCornerOrientation(Position::DRF, 1);
-	updateCornerOrientation(Position::DLF, 2);
-	updateCornerOrientation(Position::ULF, 1);
+// The packed format is little-endian; the bulk routines copy whole words into and out of the byte stream
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The bulk packed state routines assume a little-endian target");
 
-	setPrevMove(Move::Fi);
-	return *this;
+uint64_t Cube2Pieces::packState(uint64_t state)
+{
+#if defined(__BMI2__)
+	return _pext_u64(state, packedBits);
+#else
+	uint64_t packed = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint64_t corner = (state >> (i * 8)) & 0xFF;
+		packed |= ((corner & 0x3) | ((corner >> 2) & 0x1C)) << (i * 5);
+	}
+	return packed;
+#endif
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateBi()
+uint64_t Cube2Pieces::unpackState(uint64_t packed)
 {
-	Corner tmp = corners[static_cast<uint8_t>(Position::URB)];
-	corners[static_cast<uint8_t>(Position::URB)] = corners[static_cast<uint8_t>(Position::ULB)];
-	corners[static_cast<uint8_t>(Position::ULB)] = corners[static_cast<uint8_t>(Position::DLB)];
-	corners[static_cast<uint8_t>(Position::DLB)] = corners[static_cast<uint8_t>(Position::DRB)];
-	corners[static_cast<uint8_t>(Position::DRB)] = tmp;
-
-	updateCornerOrientation(Position::URB, 1);
-	updateCornerOrientation(Position::ULB, 2);
-	updateCornerOrientation(Position::DLB, 1);
-	updateCornerOrientation(Position::DRB, 2);
-
-	setPrevMove(Move::Bi);
-	return *this;
+#if defined(__BMI2__)
+	return _pdep_u64(packed, packedBits);
+#else
+	uint64_t state = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint64_t bits = (packed >> (i * 5)) & 0x1F;
+		state |= ((bits & 0x3) | ((bits & 0x1C) << 2)) << (i * 8);
+	}
+	return state;
+#endif
+}
+
+bool Cube2Pieces::isValidState(uint64_t state)
+{
+	const uint64_t lowBits = 0x0101010101010101ULL;
+	// No orientation may be 3, and the orientations must add up to a multiple of 3
+	if (state & (state >> 1) & lowBits)
+		return false;
+	int twist = __builtin_popcountll(state & lowBits) + 2 * __builtin_popcountll(state & (lowBits << 1));
+	if (twist % 3 != 0)
+		return false;
+	// Every piece must appear once: turn each piece number into its bit and OR the 8 bytes together
+#if defined(__SSSE3__)
+	const __m128i pieceBits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i pieces = _mm_cvtsi64_si128(static_cast<long long>((state >> 4) & 0x0707070707070707ULL));
+	uint64_t seen = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_shuffle_epi8(pieceBits, pieces)));
+	seen |= seen >> 32;
+	seen |= seen >> 16;
+	seen |= seen >> 8;
+	return (seen & 0xFF) == 0xFF;
+#else
+	uint8_t seenPieces = 0;
+	for (uint8_t i = 0; i < 8; i++)
+		seenPieces |= 1 << ((state >> (i * 8 + 4)) & 0x7);
+	return seenPieces == 0xFF;
+#endif
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateU2()
+uint64_t Cube2Pieces::packedState() const
 {
-	swap_items(corners[static_cast<uint8_t>(Position::URF)], corners[static_cast<uint8_t>(Position::ULB)]);
-	swap_items(corners[static_cast<uint8_t>(Position::ULF)], corners[static_cast<uint8_t>(Position::URB)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::U2);
-	return *this;
+	return packState(state);
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateD2()
+Cube2Pieces Cube2Pieces::fromPackedState(uint64_t packed)
 {
-	swap_items(corners[static_cast<uint8_t>(Position::DRF)], corners[static_cast<uint8_t>(Position::DLB)]);
-	swap_items(corners[static_cast<uint8_t>(Position::DLF)], corners[static_cast<uint8_t>(Position::DRB)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::D2);
-	return *this;
+	uint64_t state = unpackState(packed);
+	if ((packed >> 40) != 0 || !isValidState(state))
+		throw std::invalid_argument("Error: invalid packed cube state.");
+	Cube2Pieces res;
+	res.state = state;
+	res.anchor = findAnchor(state);
+	return res;
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateR2()
+void Cube2Pieces::serialize(const Cube2Pieces* cubes, size_t count, uint8_t* out)
 {
-	swap_items(corners[static_cast<uint8_t>(Position::URF)], corners[static_cast<uint8_t>(Position::DRB)]);
-	swap_items(corners[static_cast<uint8_t>(Position::DRF)], corners[static_cast<uint8_t>(Position::URB)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::R2);
-	return *this;
+	if (count == 0)
+		return;
+	// Store a whole word for every state but the last. Its top 3 bytes are overwritten by the next state.
+	for (size_t i = 0; i + 1 < count; i++)
+	{
+		uint64_t packed = packState(cubes[i].state);
+		std::memcpy(out + i * packedSize, &packed, sizeof(packed));
+	}
+	uint64_t last = packState(cubes[count - 1].state);
+	std::memcpy(out + (count - 1) * packedSize, &last, packedSize);
+}
+
+void Cube2Pieces::deserialize(const uint8_t* in, size_t count, Cube2Pieces* out)
+{
+	const uint64_t packedMask = (1ULL << 40) - 1;
+	auto store = [&](size_t i, uint64_t packed) {
+		uint64_t state = unpackState(packed & packedMask);
+		if (!isValidState(state))
+			throw std::invalid_argument("Error: invalid packed cube state at index " + std::to_string(i) + ".");
+		out[i].setPrevMove(Move::None);
+		out[i].state = state;
+		out[i].anchor = findAnchor(state);
+		out[i].canonicalKey = invalidKey;
+	};
+	if (count == 0)
+		return;
+	// Load a whole word for every state but the last, and drop the 3 bytes of the next state
+	for (size_t i = 0; i + 1 < count; i++)
+	{
+		uint64_t packed;
+		std::memcpy(&packed, in + i * packedSize, sizeof(packed));
+		store(i, packed);
+	}
+	uint64_t last = 0;
+	std::memcpy(&last, in + (count - 1) * packedSize, packedSize);
+	store(count - 1, last);
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateL2()
+void Cube2Pieces::serializeIndices(const Cube2Pieces* cubes, size_t count, uint32_t* out)
 {
-	swap_items(corners[static_cast<uint8_t>(Position::ULF)], corners[static_cast<uint8_t>(Position::DLB)]);
-	swap_items(corners[static_cast<uint8_t>(Position::DLF)], corners[static_cast<uint8_t>(Position::ULB)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::L2);
-	return *this;
+	for (size_t i = 0; i < count; i++)
+		out[i] = cubes[i].stateIndex();
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateF2()
+void Cube2Pieces::deserializeIndices(const uint32_t* in, size_t count, Cube2Pieces* out)
 {
-	swap_items(corners[static_cast<uint8_t>(Position::URF)], corners[static_cast<uint8_t>(Position::DLF)]);
-	swap_items(corners[static_cast<uint8_t>(Position::DRF)], corners[static_cast<uint8_t>(Position::ULF)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::F2);
-	return *this;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (in[i] >= numStates)
+			throw std::invalid_argument("Error: invalid state index at index " + std::to_string(i) + ".");
+		out[i] = fromStateIndex(in[i]);
+	}
 }
 
-Cube2Pieces::AbstractCube& Cube2Pieces::rotateB2()
+uint16_t Cube2Pieces::keyToPermutationIndex(uint64_t key)
 {
-	swap_items(corners[static_cast<uint8_t>(Position::URB)], corners[static_cast<uint8_t>(Position::DLB)]);
-	swap_items(corners[static_cast<uint8_t>(Position::ULB)], corners[static_cast<uint8_t>(Position::DRB)]);
-	// Note that the orientation of the pieces does not change in double moves.
-	setPrevMove(Move::B2);
-	return *this;
+	// Lehmer code of the pieces in positions 1-7: digit i counts the later pieces that are smaller.
+	// Every piece appears once, so those are the smaller pieces that have not been seen yet (position 0 included).
+	uint8_t seen = 1 << (key & 0x7);
+	uint16_t index = 0;
+	for (uint8_t i = 1; i < 8; i++)
+	{
+		uint8_t piece = (key >> (i * 3)) & 0x7;
+		uint8_t smaller = piece - __builtin_popcount(seen & ((1u << piece) - 1));
+		seen |= 1 << piece;
+		index = index * (8 - i) + smaller;
+	}
+	return index;
 }
 
-bool Cube2Pieces::isSolved() const
+uint16_t Cube2Pieces::keyToOrientationIndex(uint64_t key)
 {
-	// Compare to the solved state of the cube
-	// TODO: can just manually put in the value of the hash of the solved state to avoid instantiating a solved cube
-	Cube2Pieces solved;
-	return this->cubeHash() == solved.cubeHash();
+	uint16_t index = 0;
+	for (uint8_t i = 1; i < 7; i++)
+		index = index * 3 + ((key >> (24 + i * 2)) & 0x3);
+	return index;
 }
 
-std::string Cube2Pieces::toString() const
+Cube2Pieces Cube2Pieces::fromCoordinates(uint16_t permutation, uint16_t orientation)
 {
-	std::stringstream ss;
-	for (uint8_t i = 0; i < 8; i++)
+	if (permutation >= numPermutations || orientation >= numOrientations)
+		throw std::out_of_range("Error: fromCoordinates called with coordinates out of range.");
+
+	// Undo the Lehmer code: the digits are read back from the least significant one (position 7)
+	std::array<uint8_t, 8> digits{};
+	for (uint8_t i = 7; i >= 1; i--)
 	{
-		ss << positionToStringMap[i] << ": ";
-		ss << pieceToStringMap[static_cast<uint8_t>(corners[i].piece)] << " ";
-		ss << static_cast<int>(corners[i].orientation) << std::endl;
+		digits[i] = permutation % (8 - i);
+		permutation /= (8 - i);
+	}
+	// Digit i picks the digits[i]-th smallest of the pieces not yet placed
+	std::array<bool, 8> used{};
+	std::array<uint8_t, 8> pieces{};
+	for (uint8_t i = 1; i < 8; i++)
+	{
+		uint8_t piece = 1;
+		for (uint8_t skip = digits[i]; used[piece] || skip > 0; piece++)
+			if (!used[piece])
+				skip--;
+		pieces[i] = piece;
+		used[piece] = true;
 	}
-	return ss.str();
-}
 
-uint32_t Cube2Pieces::permutationHash() const
-{
-	Cube2Pieces normalized = *this;
-	normalized.normalize();
-	uint32_t hash = 0;
-	// Since pieces are in the range 0-7, each of the pieces understood as integers can be represented in 3 bits.
-	// And we have 8 pieces, so we need 24 bits to represent the permutation of the pieces.
+	std::array<uint8_t, 8> orientations{};
+	uint8_t twistSum = 0;
+	for (uint8_t i = 6; i >= 1; i--)
+	{
+		orientations[i] = orientation % 3;
+		orientation /= 3;
+		twistSum += orientations[i];
+	}
+	orientations[7] = (3 - twistSum % 3) % 3;
+
+	Cube2Pieces cube;
+	cube.state = 0;
 	for (uint8_t i = 0; i < 8; i++)
-		hash |= static_cast<uint32_t>(normalized.corners[i].piece) << (i * 3);
-	return hash;
+		cube.state |= (static_cast<uint64_t>(pieces[i]) << (i * 8 + 4)) | (static_cast<uint64_t>(orientations[i]) << (i * 8));
+	return cube;
 }
 
-uint32_t Cube2Pieces::orientationHash() const
+const std::array<std::array<uint16_t, 19>, Cube2Pieces::numPermutations> Cube2Pieces::permutationMoveTable = Cube2Pieces::buildPermutationMoveTable();
+
+std::array<std::array<uint16_t, 19>, Cube2Pieces::numPermutations> Cube2Pieces::buildPermutationMoveTable()
 {
-	Cube2Pieces normalized = *this;
-	normalized.normalize();
-	uint32_t hash = 0;
-	// Similar idea to the permutation hash, but we only need 2 bits to represent the orientation of a piece.
-	// Since we are in the range 0-2, we can represent the orientation of 8 pieces in 16 bits.
-	for (uint8_t i = 0; i < 8; i++)
-		hash |= static_cast<uint32_t>(normalized.corners[i].orientation) << (i * 2);
-	return hash;
+	std::array<std::array<uint16_t, 19>, numPermutations> res{};
+	for (uint16_t perm = 0; perm < numPermutations; perm++)
+	{
+		const Cube2Pieces cube = fromCoordinates(perm, 0);
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			Cube2Pieces next = cube;
+			res[perm][m] = next.turn(static_cast<Move>(m)).permutationIndex();
+		}
+	}
+	return res;
 }
 
-uint64_t Cube2Pieces::cubeHash() const
+const std::array<std::array<uint16_t, 19>, Cube2Pieces::numOrientations> Cube2Pieces::orientationMoveTable = Cube2Pieces::buildOrientationMoveTable();
+
+std::array<std::array<uint16_t, 19>, Cube2Pieces::numOrientations> Cube2Pieces::buildOrientationMoveTable()
 {
-	Cube2Pieces normalized = *this;
-	normalized.normalize();
-	uint64_t hash = 0;
-	for (uint8_t i = 0; i < 8; i++)
-		hash |= static_cast<uint64_t>(normalized.corners[i].piece) << (i * 3);
-	for (uint8_t i = 0; i < 8; i++)
-		hash |= static_cast<uint64_t>(normalized.corners[i].orientation) << (24 + i * 2);
-	return hash;
+	std::array<std::array<uint16_t, 19>, numOrientations> res{};
+	for (uint16_t ori = 0; ori < numOrientations; ori++)
+	{
+		const Cube2Pieces cube = fromCoordinates(0, ori);
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			Cube2Pieces next = cube;
+			res[ori][m] = next.turn(static_cast<Move>(m)).orientationIndex();
+		}
+	}
+	return res;
 }
 
 /*
@@ -353,88 +565,76 @@ bool operator!=(const Cube2Pieces& lhs, const Cube2Pieces& rhs)
 	return !(lhs == rhs);
 }
 
-/*
- * Private member functions
-*/
-void Cube2Pieces::updateCornerOrientation(Position pos, uint8_t numRotate)
-{
-	// Read the preface at the top of the header file. The value we assign here is the number of clockwise
-	// twists we need to perform on a corner until the corner is oriented correctly.j
-	corners[static_cast<uint8_t>(pos)].orientation = (corners[static_cast<uint8_t>(pos)].orientation + numRotate) % 3; 
-}
-
 /*
  * Normalizing experimentation
 */
 
 Cube2Pieces& Cube2Pieces::cubeRotateX()
 {
-	rotateR();
-	rotateLi();
+	turn(Move::R);
+	turn(Move::Li);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateY()
 {
-	rotateU();
-	rotateDi();
+	turn(Move::U);
+	turn(Move::Di);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateZ()
 {
-	rotateF();
-	rotateBi();
+	turn(Move::F);
+	turn(Move::Bi);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateXi()
 {
-	rotateRi();
-	rotateL();
+	turn(Move::Ri);
+	turn(Move::L);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateYi()
 {
-	rotateUi();
-	rotateD();
+	turn(Move::Ui);
+	turn(Move::D);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateZi()
 {
-	rotateFi();
-	rotateB();
+	turn(Move::Fi);
+	turn(Move::B);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateX2()
 {
-	rotateR2();
-	rotateL2();
+	turn(Move::R2);
+	turn(Move::L2);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateY2()
 {
-	rotateU2();
-	rotateD2();
+	turn(Move::U2);
+	turn(Move::D2);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::cubeRotateZ2()
 {
-	rotateF2();
-	rotateB2();
+	turn(Move::F2);
+	turn(Move::B2);
 	return *this;
 }
 
 Cube2Pieces& Cube2Pieces::normalize()
 {
 	/*
-	 * TODO: probably want to track the position index of WRB as a member variable
-	 * 
 	 * The idea is that the WRB corner piece has some position index. Given a state of the cube
 	 * we can rotate the entire cube such that the WRB corner piece is in the URF position with orientation 0.
 	 * This allows us to compare two states of the cube that are equivalent up to a rotation of the entire cube.
@@ -446,127 +646,12 @@ Cube2Pieces& Cube2Pieces::normalize()
 	 * Also, done correctly, this means that we can reduce the size of the individual hashes by recognizing that 
 	 * since the first entry in the hash is the WRB corner piece, we do not need to store this information;
 	 * we only need to hash information about the other 7 pieces.
+	 *
+	 * Every move keeps the anchor (position and orientation of WRB) up to date, so the rotation we need
+	 * is a single precomputed transform selected by the anchor.
 	*/
-
-	// TODO: this is the part we need to track of as member variable
-	// Extract the index of the WRB corner piece
-	uint8_t WRBidx = 0;
-	while (corners[WRBidx].piece != Piece::WRB)
-		WRBidx++;
-
-	/*
-	 * Given a position and orientatino of the WRB corner pieces, we can rotate the cube such that WRB is in the URG position
-	 * with W in U and R in F (that is, with orientation 0).
-	 * The correct rotation for a given positions/orientation was manually computed.
-	*/
-	Position WRBpos = static_cast<Position>(WRBidx);
-	if (WRBpos == Position::URF && corners[WRBidx].orientation == 0)
-		; // Already good
-	else if (WRBpos == Position::URF && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateX();
-		cubeRotateY();
-	}
-	else if (WRBpos == Position::URF && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateXi();
-		cubeRotateZi();
-	}
-	else if (WRBpos == Position::ULF && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateYi();
-	}
-	else if (WRBpos == Position::ULF && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateZ();
-	}
-	else if (WRBpos == Position::ULF && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateY2();
-		cubeRotateXi();
-	}
-	else if (WRBpos == Position::ULB && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateY2();
-	}
-	else if (WRBpos == Position::ULB && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateYi();
-		cubeRotateZ();
-	}
-	else if (WRBpos == Position::ULB && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateXi();
-		cubeRotateZ();
-	}
-	else if (WRBpos == Position::URB && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateY();
-	}
-	else if (WRBpos == Position::URB && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateY2();
-		cubeRotateZ();
-	}
-	else if (WRBpos == Position::URB && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateXi();
-	}
-	else if (WRBpos == Position::DRF && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateX2();
-		cubeRotateY();
-	}
-	else if (WRBpos == Position::DRF && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateZi();
-	}
-	else if (WRBpos == Position::DRF && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateX();
-	}
-	else if (WRBpos == Position::DLF && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateZ2();
-	}
-	else if (WRBpos == Position::DLF && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateX();
-		cubeRotateYi();
-	}
-	else if (WRBpos == Position::DLF && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateYi();
-		cubeRotateX();
-	}
-	else if (WRBpos == Position::DLB && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateX2();
-		cubeRotateYi();
-	}
-	else if (WRBpos == Position::DLB && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateY2();
-		cubeRotateZi();
-	}
-	else if (WRBpos == Position::DLB && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateY2();
-		cubeRotateX();
-	}
-	else if (WRBpos == Position::DRB && corners[WRBidx].orientation == 0)
-	{
-		cubeRotateX2();
-	}
-	else if (WRBpos == Position::DRB && corners[WRBidx].orientation == 1)
-	{
-		cubeRotateXi();
-		cubeRotateY();
-	}
-	else if (WRBpos == Position::DRB && corners[WRBidx].orientation == 2)
-	{
-		cubeRotateY();
-		cubeRotateX();
-	}
+	state = applyTransform(state, normalizationTables[anchor]);
+	anchor = 0;
+	// The canonical key, if cached, is still valid
 	return *this;
 }
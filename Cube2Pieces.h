@@ -5,8 +5,20 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <cstring>
+#include <vector>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 #include "ABCCube.h"
+#include "Cube2Tables.h"
 
 /* --------------------------------------------------------------------------------------------
  * This file contains the class definition for a 2x2x2 "piecewise" representation of 
@@ -24,9 +36,10 @@
  * exists in the U or D layer. Since orientations cycle every 3 twists, we say the orientation
  * ranges from 0-2.
  * 
- * Thus we represent the cube with an array of 8 Corner objects. A Corner object identifies
- * the color of the piece and its orientation. The index in the array corresponds to the
- * position of the piece in the cube.
+ * Thus we represent the cube with 8 corners, each identified by the color of the piece and its
+ * orientation. The corners are packed into a single 64-bit word, one byte per position:
+ * bits 0-1 of a byte hold the orientation and bits 4-6 hold the piece. The byte index in the
+ * word corresponds to the position of the piece in the cube.
  * 
  *  0   1   2   3   4   5   6   7
  * URF ULF ULB URB DRF DLF DLB DRB
@@ -49,37 +62,38 @@
  * --------------------------------------------------------------------------------------------
 */
 
-class Cube2Pieces : public AbstractCube
+class Cube2Pieces final : public CubeEngine<Cube2Pieces>
 {
 public:
 	// Standard constructors
 	Cube2Pieces(); 
 	explicit Cube2Pieces(const std::string& moves) : Cube2Pieces() { applyMoves(moves); }
-	Cube2Pieces(const Cube2Pieces& other); // Copy constructor
-
-	std::unique_ptr<AbstractCube> clone() const override;
-
-	// Rotations
-	AbstractCube& rotateU() override;
-	AbstractCube& rotateD() override;
-	AbstractCube& rotateR() override;
-	AbstractCube& rotateL() override;
-	AbstractCube& rotateF() override;
-	AbstractCube& rotateB() override;
-
-	AbstractCube& rotateUi() override;
-	AbstractCube& rotateDi() override;
-	AbstractCube& rotateRi() override;
-	AbstractCube& rotateLi() override;
-	AbstractCube& rotateFi() override;
-	AbstractCube& rotateBi() override;
-
-	AbstractCube& rotateU2() override;
-	AbstractCube& rotateD2() override;
-	AbstractCube& rotateR2() override;
-	AbstractCube& rotateL2() override;
-	AbstractCube& rotateF2() override;
-	AbstractCube& rotateB2() override;
+	Cube2Pieces(const Cube2Pieces& other) = default; // Copy constructor
+	Cube2Pieces& operator=(const Cube2Pieces& other) = default;
+
+	// Apply a single move. The rotate functions, applyMoves and getSuccessors are built on
+	// this by CubeEngine. It is defined here so that it can be inlined into the solvers.
+	inline Cube2Pieces& turn(Move move);
+
+	/*
+	 * A scramble parsed once and compiled into its move sequence and a single corner transform with the
+	 * same effect as the whole sequence. Applying it to a cube costs one move, however long the scramble,
+	 * so jobs that set up many cubes from the same scramble only pay for parsing once.
+	*/
+	class CompiledScramble
+	{
+	public:
+		explicit CompiledScramble(std::string_view moves);
+		const std::vector<Move>& getMoves() const { return moves; }
+	private:
+		friend class Cube2Pieces;
+		friend class CubeBatch;
+		std::vector<Move> moves;
+		Cube2Tables::CornerTransform transform;
+	};
+
+	// Apply a compiled scramble. Like applyMoves, this records the last move of the scramble as the previous move.
+	Cube2Pieces& applyScramble(const CompiledScramble& scramble);
 
 	/*
 	 * These are attempts to normalize the cube.
@@ -99,13 +113,163 @@ public:
 
 	Cube2Pieces& normalize();
 
-	bool isSolved() const override;
+	bool isSolved() const override { return cubeHash() == solvedKey; }
 
 	std::string toString() const override;
 
-	uint32_t permutationHash() const;
-	uint32_t orientationHash() const;
-	uint64_t cubeHash() const;
+	/*
+	 * All three hashes are taken from the canonical key: the normalized cube with the pieces in
+	 * bits 0-23 (3 bits per position) and the orientations in bits 24-39 (2 bits per position).
+	 * The key is computed once per state and cached until the next move, so hashing the same
+	 * state several times (A*, the heuristics, isSolved) only normalizes it once.
+	 * Note that this makes concurrent reads of the same cube object unsafe.
+	*/
+	// The canonical key of the solved cube: every piece in its own position with orientation 0
+	static constexpr uint64_t solvedKey = [] {
+		uint64_t key = 0;
+		for (uint64_t i = 0; i < 8; i++)
+			key |= i << (i * 3);
+		return key;
+	}();
+
+	/*
+	 * Goals for the solvers on the canonical key. solvedGoal is the same test as isSolved. orientedGoal
+	 * only asks for the U/D colors of every corner to face U or D, and permutedGoal only asks for every
+	 * corner to be in its place. stateGoal asks for a specific state (up to whole-cube rotation).
+	*/
+	static constexpr CubeGoal solvedGoal{ 0xFFFFFFFFFFULL, solvedKey };
+	static constexpr CubeGoal orientedGoal{ 0xFFFF000000ULL, 0 };
+	static constexpr CubeGoal permutedGoal{ 0xFFFFFFULL, solvedKey & 0xFFFFFFULL };
+	static CubeGoal stateGoal(const Cube2Pieces& target) { return { 0xFFFFFFFFFFULL, target.cubeHash() }; }
+
+	bool isGoal(const CubeGoal& goal) const { return goal.matches(cubeHash()); }
+
+	/*
+	 * Symmetry reduction. Besides whole-cube rotations, which the canonical key already ignores, a cube is
+	 * equivalent to its recolorings by a rotation and to its mirror image: they have solutions of the same
+	 * length, obtained by mapping the moves. symmetryHash is the smallest canonical key over all 48 such
+	 * images, so it is the same for every cube in a symmetry class. There are 77,802 classes, against
+	 * 3,674,160 states. It is computed on demand and not cached.
+	*/
+	uint64_t symmetryHash() const;
+
+	// Which of the 48 images a representative is: the anchor of the image before normalizing, and whether it was mirrored
+	struct Symmetry
+	{
+		uint8_t anchor;
+		bool mirrored;
+	};
+
+	// The normalized image of this cube whose canonical key is symmetryHash(). A sequence of moves that solves the
+	// representative solves this cube once every move is mapped with mapSymmetricMove.
+	Cube2Pieces symmetryRepresentative(Symmetry& symmetry) const;
+	static Move mapSymmetricMove(const Symmetry& symmetry, Move move);
+
+	// The inverse state: the piece at position i with orientation o goes back to its own position, so in the
+	// inverse the piece i sits in that position with orientation -o. Solving it takes as many moves as
+	// solving this cube (the solution is the inverse sequence, up to a whole-cube rotation).
+	Cube2Pieces inverse() const;
+
+	// The mirror image of this cube (reflected left to right), and of a move
+	Cube2Pieces mirrored() const;
+	static Move mirrorMove(Move move) { return mirrorMoves[static_cast<uint8_t>(move)]; }
+
+	uint32_t permutationHash() const { return static_cast<uint32_t>(cubeHash() & 0xFFFFFF); }
+	uint32_t orientationHash() const { return static_cast<uint32_t>(cubeHash() >> 24); }
+	inline uint64_t cubeHash() const;
+
+	/*
+	 * Dense coordinates of the normalized cube. With WRB fixed at URF with orientation 0, the other
+	 * 7 pieces can be in any of 7! = 5040 arrangements, ranked by their Lehmer code. Their orientations
+	 * always sum to a multiple of 3, so the orientations of positions ULF to DLF (base 3) determine
+	 * the last one, giving 3^6 = 729 values. Together they index all 3,674,160 states.
+	*/
+	static constexpr uint16_t numPermutations = 5040;
+	static constexpr uint16_t numOrientations = 729;
+	static constexpr uint32_t numStates = static_cast<uint32_t>(numPermutations) * numOrientations;
+
+	uint16_t permutationIndex() const { return keyToPermutationIndex(cubeHash()); }
+	uint16_t orientationIndex() const { return keyToOrientationIndex(cubeHash()); }
+	uint32_t stateIndex() const { return keyToStateIndex(cubeHash()); }
+
+	// The same coordinates computed from a canonical key (e.g. one read back from a lookup file)
+	static uint16_t keyToPermutationIndex(uint64_t key);
+	static uint16_t keyToOrientationIndex(uint64_t key);
+	static uint32_t keyToStateIndex(uint64_t key) { return static_cast<uint32_t>(keyToPermutationIndex(key)) * numOrientations + keyToOrientationIndex(key); }
+
+	// Build the normalized cube with the given coordinates
+	static Cube2Pieces fromCoordinates(uint16_t permutation, uint16_t orientation);
+	static Cube2Pieces fromStateIndex(uint32_t index) { return fromCoordinates(index / numOrientations, index % numOrientations); }
+
+	/*
+	 * Coordinate transition tables: the coordinate of the normalized cube after a move is applied to the
+	 * normalized cube with the given coordinate. A move takes WRB from URF with orientation 0 to the same
+	 * anchor no matter what the rest of the cube looks like, so the renormalizing rotation depends only on
+	 * the move, and the new permutation (orientation) depends only on the old permutation (orientation).
+	*/
+	static uint16_t permutationMove(uint16_t permutation, Move move) { return permutationMoveTable[permutation][static_cast<uint8_t>(move)]; }
+	static uint16_t orientationMove(uint16_t orientation, Move move) { return orientationMoveTable[orientation][static_cast<uint8_t>(move)]; }
+
+	// The move that has the same effect on this cube as the given move has on its normalized copy.
+	// Only valid for moves that keep WRB at URF (D, B, L and their variants), which do not renormalize.
+	Move fromNormalizedFrame(Move move) const { return conjugationTables[anchor][static_cast<uint8_t>(move)]; }
+
+	/*
+	 * Fixed-corner move generation. The D, B and L turns never move the URF corner, and every turn of
+	 * U, F or R is a turn of the opposite face followed by a whole-cube rotation. So a normalized cube
+	 * (WRB at URF) stays normalized under these 9 moves, and they reach every state in as few moves as
+	 * all 18 do. The branching factor drops from about 13 to 6 (the three faces are pairwise adjacent,
+	 * so only the same-face rule prunes), and the canonical key of a normalized cube needs no rotation.
+	 * The moves found this way act on the normalized copy of a cube; see fromNormalizedFrame.
+	*/
+	static constexpr std::array<Move, 9> fixedCornerMoves = {
+		Move::D, Move::Di, Move::D2, Move::B, Move::Bi, Move::B2, Move::L, Move::Li, Move::L2
+	};
+
+	// Like getSuccessors, restricted to fixedCornerMoves. Meant for normalized cubes.
+	void getFixedCornerSuccessors(SuccessorBuffer<Cube2Pieces>& buffer, Metric metric = Metric::HTM) const;
+
+	/*
+	 * Facelet input and output, for states that come from the stickers of a real cube rather than from a
+	 * scramble. See Cube2Tables.h for the layout of a facelet string: 24 colors from "WBRYGO", face by face
+	 * in the order U, R, F, D, L, B, e.g. "WWWWBBBBRRRRYYYYGGGGOOOO" for the solved cube.
+	 * A state is rejected if a character is not a color, if the stickers of a corner do not form one of the
+	 * 8 pieces (in clockwise order), if a piece appears twice, or if the twists do not add up to a multiple
+	 * of 3 (a single twisted corner).
+	*/
+	enum class FaceletStatus : uint8_t { Valid, BadLength, BadColor, BadCorner, DuplicatePiece, BadTwist };
+
+	// Throws std::invalid_argument if the facelets are not a valid state
+	static Cube2Pieces fromFacelets(std::string_view facelets);
+
+	// Parse count facelet strings of 24 characters each, stored back to back. Cube i is written to out[i] and
+	// its status to status[i]; the cubes of invalid states are left solved. Returns the number of valid states.
+	static size_t fromFacelets(const char* facelets, size_t count, Cube2Pieces* out, FaceletStatus* status);
+
+	std::string toFacelets() const;
+
+	/*
+	 * Compact binary encoding, for moving states between programs or storing them in bulk. The packed
+	 * state is the state word with the unused bits squeezed out: 5 bits per position, position i in
+	 * bits 5i to 5i + 4, with the orientation in the low 2 bits and the piece in the high 3. That is 40
+	 * bits, stored as 5 bytes, least significant first. Unlike the canonical key, it keeps the
+	 * orientation of the whole cube, so unpacking gives back exactly the same state. The previous move
+	 * is not stored.
+	 *
+	 * When the orientation of the whole cube does not matter, stateIndex (and fromStateIndex) is a
+	 * 32-bit encoding of the normalized cube.
+	*/
+	static constexpr size_t packedSize = 5;
+	uint64_t packedState() const;
+	// Throws std::invalid_argument if the value is not a valid packed state
+	static Cube2Pieces fromPackedState(uint64_t packed);
+
+	// Bulk versions: count cubes to and from count * packedSize bytes, or count state indices.
+	// The deserializers throw std::invalid_argument on the first invalid state.
+	static void serialize(const Cube2Pieces* cubes, size_t count, uint8_t* out);
+	static void deserialize(const uint8_t* in, size_t count, Cube2Pieces* out);
+	static void serializeIndices(const Cube2Pieces* cubes, size_t count, uint32_t* out);
+	static void deserializeIndices(const uint32_t* in, size_t count, Cube2Pieces* out);
 
 	friend bool operator==(const Cube2Pieces& lhs, const Cube2Pieces& rhs);
 	friend bool operator!=(const Cube2Pieces& lhs, const Cube2Pieces& rhs);
@@ -113,20 +277,152 @@ public:
 	~Cube2Pieces() override = default; // Explicitly default if no custom behavior is needed
 
 private:
-	enum class Position : uint8_t { URF, ULF, ULB, URB, DRF, DLF, DLB, DRB };
+	using Position = Cube2Tables::Position;
+	using CornerTransform = Cube2Tables::CornerTransform;
 	enum class Piece : uint8_t { WRB, WRG, WOG, WOB, YRB, YRG, YOG, YOB };
 
 	static const std::array<std::string, 8> positionToStringMap;
 	static const std::array<std::string, 8> pieceToStringMap;
 
-	struct Corner
-	{
-		Piece piece;
-		uint8_t orientation;
-	};
+	// One transform per Move, indexed by the underlying value of the Move (None is the identity)
+	static constexpr std::array<CornerTransform, 19> moveTables = Cube2Tables::buildMoveTables();
+
+	/*
+	 * The anchor is the position and orientation of the WRB corner, encoded as position * 3 + orientation.
+	 * anchorTables[move][anchor] is the anchor after applying move, and normalizationTables[anchor] is the
+	 * whole-cube rotation that brings WRB from that anchor to URF with orientation 0 (anchor 0).
+	 */
+	static constexpr std::array<std::array<uint8_t, 24>, 19> anchorTables = Cube2Tables::buildAnchorTables(moveTables);
+	static constexpr std::array<CornerTransform, 24> normalizationTables = Cube2Tables::buildNormalizationTables(moveTables);
+
+	// conjugationTables[anchor][move] is the move M with normalizationTables[anchor] * move = M * normalizationTables[anchor]
+	static constexpr std::array<std::array<Move, 19>, 24> conjugationTables = Cube2Tables::buildConjugationTables(moveTables, normalizationTables);
+
+	// Recoloring tables for the 24 rotations in normalizationTables, used by the symmetry reduction
+	static constexpr std::array<uint64_t, 24> recolorTables = Cube2Tables::buildRecolorTables(normalizationTables);
+
+	// Lookup tables for the facelet parser
+	static constexpr std::array<uint8_t, 256> colorIndex = Cube2Tables::buildColorIndex();
+	static constexpr std::array<uint8_t, 216> cornerColors = Cube2Tables::buildCornerColors();
+	// Parse and check 24 facelets into a state word. With writeColors, colors receives the color index of every
+	// facelet, which is the sticker form of the same state (see Cube2Stickers); otherwise it is not used.
+	template <bool writeColors>
+	static FaceletStatus parseFacelets(const char* facelets, uint64_t& state, uint8_t* colors);
+	// The same for a facelet string of any length, throwing the std::invalid_argument of fromFacelets
+	static void parseFaceletsOrThrow(std::string_view facelets, uint64_t& state, uint8_t* colors = nullptr);
+
+	// mirrorMoves[move] is the move that has the same effect on the mirror image of a cube
+	static constexpr std::array<Move, 19> mirrorMoves = Cube2Tables::buildMirrorMoves();
+
+	static_assert(Cube2Tables::checkInverses(moveTables), "Every move followed by its inverse must be the identity");
+	static_assert(Cube2Tables::checkNormalization(normalizationTables), "Every normalization must bring WRB to anchor 0");
+	static_assert(Cube2Tables::checkConjugation(conjugationTables), "Conjugation by the identity rotation must fix every move");
+	static_assert(Cube2Tables::checkMirror(mirrorMoves), "Mirroring must be an involution that commutes with inversion");
+
+	// Coordinate transition tables, see permutationMove and orientationMove. These are built at startup
+	// from fromCoordinates and turn rather than at compile time, which would take too many constexpr steps.
+	static const std::array<std::array<uint16_t, 19>, numPermutations> permutationMoveTable;
+	static const std::array<std::array<uint16_t, 19>, numOrientations> orientationMoveTable;
+	static std::array<std::array<uint16_t, 19>, numPermutations> buildPermutationMoveTable();
+	static std::array<std::array<uint16_t, 19>, numOrientations> buildOrientationMoveTable();
 
-	// Primary data array
-	std::array<Corner, 8> corners;
+	// Primary data word, see the preface for the layout
+	uint64_t state;
+	// Anchor of the current state, kept up to date by every move
+	uint8_t anchor;
 
-	void updateCornerOrientation(Position pos, uint8_t numRotate);
+	// Cached canonical key of the current state, invalidated by every move
+	static constexpr uint64_t invalidKey = ~0ULL;
+	mutable uint64_t canonicalKey;
+	uint64_t computeCanonicalKey() const;
+	static uint64_t canonicalKeyOf(uint64_t state, uint8_t anchor);
+
+	// Helpers for the symmetry reduction on raw state words
+	std::pair<uint64_t, uint64_t> findSymmetryRepresentative(Symmetry& symmetry) const;
+	static uint64_t recolor(uint64_t state, uint64_t recolorTable);
+	static uint64_t mirrorState(uint64_t state);
+	static uint8_t findAnchor(uint64_t state);
+
+	// Whether a state word holds 8 distinct pieces with orientations 0-2 that add up to a multiple of 3
+	static bool isValidState(uint64_t state);
+	// Bits of the state word that the packed state keeps: orientation and piece of every byte
+	static constexpr uint64_t packedBits = 0x7373737373737373ULL;
+	static uint64_t packState(uint64_t state);
+	static uint64_t unpackState(uint64_t packed);
+
+	Piece pieceAt(uint8_t pos) const { return static_cast<Piece>((state >> (pos * 8 + 4)) & 0x7); }
+	uint8_t orientationAt(uint8_t pos) const { return (state >> (pos * 8)) & 0x3; }
+
+	// applyTransform uses the SIMD kernel when the target supports SSSE3, otherwise the scalar one
+	static inline uint64_t applyTransform(uint64_t state, const CornerTransform& transform);
+	static inline uint64_t applyTransformScalar(uint64_t state, const CornerTransform& transform);
+#if defined(__SSSE3__)
+	static inline uint64_t applyTransformSimd(uint64_t state, const CornerTransform& transform);
+#endif
+
+	friend class MicroBenchmark;
+	friend class CubeBatch;
+	friend class Cube2Stickers;
 };
+
+/*
+ * Inline member functions -- the move kernels sit on the innermost loop of every search
+*/
+Cube2Pieces& Cube2Pieces::turn(Move move)
+{
+	state = applyTransform(state, moveTables[static_cast<uint8_t>(move)]);
+	anchor = anchorTables[static_cast<uint8_t>(move)][anchor];
+	canonicalKey = invalidKey;
+	setPrevMove(move);
+	return *this;
+}
+
+uint64_t Cube2Pieces::cubeHash() const
+{
+	if (canonicalKey == invalidKey)
+		canonicalKey = computeCanonicalKey();
+	return canonicalKey;
+}
+
+uint64_t Cube2Pieces::applyTransform(uint64_t state, const CornerTransform& transform)
+{
+#if defined(__SSSE3__)
+	return applyTransformSimd(state, transform);
+#else
+	return applyTransformScalar(state, transform);
+#endif
+}
+
+uint64_t Cube2Pieces::applyTransformScalar(uint64_t state, const CornerTransform& transform)
+{
+	// Gather the corners into their new positions, one byte each
+	uint64_t res = 0;
+	for (uint8_t i = 0; i < 8; i++)
+		res |= ((state >> (transform.source[i] * 8)) & 0xFF) << (i * 8);
+
+	// Add the twists to every orientation at once. Orientations are now in the range 0-4 and none
+	// of the additions carry into the piece bits. Then subtract 3 from every orientation that is 3 or 4.
+	res += transform.twist;
+	uint64_t overflow = ((res >> 2) | (res & (res >> 1))) & 0x0101010101010101ULL;
+	return res - overflow * 3;
+}
+
+#if defined(__SSSE3__)
+uint64_t Cube2Pieces::applyTransformSimd(uint64_t state, const CornerTransform& transform)
+{
+	// The 8 corners sit in the low half of a 16-byte register. One byte shuffle applies the permutation,
+	// then a second shuffle on the low nibbles reduces the twisted orientations (0-4) mod 3.
+	const __m128i mod3 = _mm_setr_epi8(0, 1, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+	int64_t source;
+	std::memcpy(&source, transform.source.data(), sizeof(source));
+
+	__m128i corners = _mm_cvtsi64_si128(static_cast<int64_t>(state));
+	corners = _mm_shuffle_epi8(corners, _mm_cvtsi64_si128(source));
+	corners = _mm_add_epi8(corners, _mm_cvtsi64_si128(static_cast<int64_t>(transform.twist)));
+	__m128i orientations = _mm_shuffle_epi8(mod3, _mm_and_si128(corners, lowNibble));
+	corners = _mm_or_si128(_mm_andnot_si128(lowNibble, corners), orientations);
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(corners));
+}
+#endif
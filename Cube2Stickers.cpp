@@ -0,0 +1,88 @@
+#include <string>
+#include <array>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "Cube2Stickers.h"
+
+/*
+ * Public member functions
+*/
+
+Cube2Stickers::Cube2Stickers() : CubeEngine()
+{
+	// In the solved cube every sticker has the color of its face, and there are 4 stickers per face
+	stickers.fill(0);
+	for (uint8_t f = 0; f < 24; f++)
+		stickers[f] = f / 4;
+}
+
+Cube2Stickers::Cube2Stickers(const Cube2Pieces& cube) : CubeEngine()
+{
+	// Same as Cube2Pieces::toFacelets, with color indices instead of characters
+	stickers.fill(0);
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		uint8_t piece = static_cast<uint8_t>(cube.pieceAt(i));
+		uint8_t k = (3 - cube.orientationAt(i)) % 3;
+		for (uint8_t j = 0; j < 3; j++)
+			stickers[Cube2Tables::cornerFacelets[i][(k + j) % 3]] = Cube2Tables::cornerFacelets[piece][j] / 4;
+	}
+}
+
+bool Cube2Stickers::isSolved() const
+{
+	// A face is solved when its 4 bytes are all equal to its first one
+	for (uint8_t face = 0; face < 6; face++)
+	{
+		uint32_t stickersOfFace;
+		std::memcpy(&stickersOfFace, stickers.data() + face * 4, sizeof(stickersOfFace));
+		if (stickersOfFace != (stickersOfFace & 0xFF) * 0x01010101u)
+			return false;
+	}
+	return true;
+}
+
+std::string Cube2Stickers::toString() const
+{
+	static const std::array<std::string, 6> faceNames = { "U", "R", "F", "D", "L", "B" };
+	std::string facelets = toFacelets();
+	std::stringstream ss;
+	for (uint8_t face = 0; face < 6; face++)
+		ss << faceNames[face] << ": " << facelets.substr(face * 4, 4) << std::endl;
+	return ss.str();
+}
+
+Cube2Stickers Cube2Stickers::fromFacelets(std::string_view facelets)
+{
+	// Checking a state takes its corners, so the parser of Cube2Pieces checks it and hands back the stickers it read
+	Cube2Stickers res;
+	uint64_t state;
+	Cube2Pieces::parseFaceletsOrThrow(facelets, state, res.stickers.data());
+	return res;
+}
+
+std::string Cube2Stickers::toFacelets() const
+{
+	std::string res(24, ' ');
+	for (uint8_t f = 0; f < 24; f++)
+		res[f] = Cube2Tables::faceColors[stickers[f]];
+	return res;
+}
+
+Cube2Pieces Cube2Stickers::toPieces() const
+{
+	// Every state reachable from the solved cube (or built from valid facelets) shows a valid corner at every position
+	Cube2Pieces res;
+	res.state = 0;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		const auto& facelets = Cube2Tables::cornerFacelets[i];
+		uint8_t corner = Cube2Pieces::cornerColors[stickers[facelets[0]] * 36 + stickers[facelets[1]] * 6 + stickers[facelets[2]]];
+		res.state |= static_cast<uint64_t>(corner) << (i * 8);
+	}
+	res.anchor = Cube2Pieces::findAnchor(res.state);
+	return res;
+}
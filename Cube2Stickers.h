@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <string>
+#include <string_view>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+#include <immintrin.h>
+#endif
+
+#include "ABCCube.h"
+#include "Cube2Tables.h"
+#include "Cube2Pieces.h"
+
+/* ----------------------------------------------------------------------------
+ * This file contains the definition for the Cube2Stickers class, a 2x2x2
+ * cube stored sticker by sticker instead of piece by piece.
+ *
+ * The state is the 24 facelets of the cube in the order of a facelet string
+ * (see Cube2Tables.h), one byte each, holding the index of the color in
+ * Cube2Tables::faceColors (0-5, i.e. the face it belongs to when solved).
+ * The 24 bytes are padded to 32 so that the whole state fits in one 256-bit
+ * register, and a move is a single byte permutation of the register:
+ * - with AVX-512 VBMI (and VL), one vpermb over the 32 bytes;
+ * - with SSSE3, two byte shuffles per 16-byte half, one for the stickers that
+ *   stay in their half and one for those that cross over;
+ * - otherwise, a scalar loop over the 24 bytes.
+ *
+ * This is the natural form for facelet input and output (vision, rendering):
+ * reading or writing the stickers is a table lookup per byte, while
+ * Cube2Pieces has to work out every corner. Cube2Pieces stays the form for
+ * searching: it hashes and normalizes, and is 8 bytes instead of 32.
+ * Converting between the two costs a few dozen table lookups.
+ * --------------------------------------------------------------------------
+*/
+class Cube2Stickers final : public CubeEngine<Cube2Stickers>
+{
+public:
+	// The solved cube
+	Cube2Stickers();
+	explicit Cube2Stickers(const Cube2Pieces& cube);
+	Cube2Stickers(const Cube2Stickers& other) = default;
+	Cube2Stickers& operator=(const Cube2Stickers& other) = default;
+
+	// Apply a single move and record it as the previous move (see CubeEngine)
+	inline Cube2Stickers& turn(Move move);
+
+	// Every face shows a single color, whatever the orientation of the whole cube
+	bool isSolved() const override;
+
+	// The colors of every face, one face per line
+	std::string toString() const override;
+
+	// Validates the facelets like Cube2Pieces::fromFacelets (and throws the same std::invalid_argument)
+	static Cube2Stickers fromFacelets(std::string_view facelets);
+	std::string toFacelets() const;
+
+	Cube2Pieces toPieces() const;
+
+	friend bool operator==(const Cube2Stickers& lhs, const Cube2Stickers& rhs) { return lhs.stickers == rhs.stickers; }
+	friend bool operator!=(const Cube2Stickers& lhs, const Cube2Stickers& rhs) { return !(lhs == rhs); }
+
+	~Cube2Stickers() override = default;
+
+private:
+	// moveTables[move][f] is the byte that the move brings to byte f, see Cube2Tables::buildStickerMoveTables.
+	// The half tables split every permutation in two for the 16-byte shuffles of the SSSE3 kernel.
+	static constexpr std::array<std::array<uint8_t, 32>, 19> moveTables = Cube2Tables::buildStickerMoveTables(Cube2Tables::buildMoveTables());
+	static constexpr std::array<std::array<uint8_t, 32>, 19> sameHalfTables = Cube2Tables::buildStickerHalfTables(moveTables, false);
+	static constexpr std::array<std::array<uint8_t, 32>, 19> crossHalfTables = Cube2Tables::buildStickerHalfTables(moveTables, true);
+
+	static_assert(Cube2Tables::checkStickerInverses(moveTables), "Every sticker move followed by its inverse must be the identity");
+
+	// The facelets in the order of a facelet string, then 8 bytes of padding (always zero)
+	alignas(32) std::array<uint8_t, 32> stickers;
+
+	// The move kernels, see the preface. turn uses the widest one the target supports.
+	inline void permuteScalar(Move move);
+#if defined(__SSSE3__)
+	inline void permuteSsse3(Move move);
+#endif
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+	inline void permuteVbmi(Move move);
+#endif
+
+	friend class MicroBenchmark;
+};
+
+/*
+ * Inline member functions -- the move kernels
+*/
+Cube2Stickers& Cube2Stickers::turn(Move move)
+{
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+	permuteVbmi(move);
+#elif defined(__SSSE3__)
+	permuteSsse3(move);
+#else
+	permuteScalar(move);
+#endif
+	setPrevMove(move);
+	return *this;
+}
+
+void Cube2Stickers::permuteScalar(Move move)
+{
+	const std::array<uint8_t, 32>& table = moveTables[static_cast<uint8_t>(move)];
+	std::array<uint8_t, 32> res{};
+	for (uint8_t f = 0; f < 24; f++)
+		res[f] = stickers[table[f]];
+	stickers = res;
+}
+
+#if defined(__SSSE3__)
+void Cube2Stickers::permuteSsse3(Move move)
+{
+	const uint8_t* same = sameHalfTables[static_cast<uint8_t>(move)].data();
+	const uint8_t* cross = crossHalfTables[static_cast<uint8_t>(move)].data();
+	__m128i low = _mm_load_si128(reinterpret_cast<const __m128i*>(stickers.data()));
+	__m128i high = _mm_load_si128(reinterpret_cast<const __m128i*>(stickers.data() + 16));
+	__m128i newLow = _mm_or_si128(_mm_shuffle_epi8(low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(same))),
+		_mm_shuffle_epi8(high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(cross))));
+	__m128i newHigh = _mm_or_si128(_mm_shuffle_epi8(high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(same + 16))),
+		_mm_shuffle_epi8(low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(cross + 16))));
+	_mm_store_si128(reinterpret_cast<__m128i*>(stickers.data()), newLow);
+	_mm_store_si128(reinterpret_cast<__m128i*>(stickers.data() + 16), newHigh);
+}
+#endif
+
+#if defined(__AVX512VBMI__) && defined(__AVX512VL__)
+void Cube2Stickers::permuteVbmi(Move move)
+{
+	__m256i state = _mm256_load_si256(reinterpret_cast<const __m256i*>(stickers.data()));
+	__m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(moveTables[static_cast<uint8_t>(move)].data()));
+	// The zero-masking form with every byte selected is the same vpermb, without the undefined source operand
+	// of _mm256_permutexvar_epi8 that GCC warns about
+	_mm256_store_si256(reinterpret_cast<__m256i*>(stickers.data()), _mm256_maskz_permutexvar_epi8(~0u, indices, state));
+}
+#endif
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "ABCCube.h"
+
+/* --------------------------------------------------------------------------------------------
+ * Compile-time tables for Cube2Pieces (and Cube2Stickers). Every function here is constexpr and Cube2Pieces stores
+ * their results in static constexpr members, so the move, anchor, normalization and conjugation
+ * tables are computed by the compiler and placed in read-only data. No code runs at program
+ * startup to build them, and they can be checked with static_assert (see Cube2Pieces.h).
+ *
+ * See the preface of Cube2Pieces.h for the layout of the state word the transforms act on.
+ * --------------------------------------------------------------------------------------------
+*/
+
+class Cube2Tables
+{
+public:
+	using Move = AbstractCube::Move;
+
+	enum class Position : uint8_t { URF, ULF, ULB, URB, DRF, DLF, DLB, DRB };
+
+	/*
+	 * A face turn moves the corner at position source[i] into position i and then twists
+	 * it by twist[i]. The twists are stored packed in the same byte layout as the state
+	 * so that they can be added to the whole state at once.
+	 */
+	struct CornerTransform
+	{
+		alignas(8) std::array<uint8_t, 8> source;
+		uint64_t twist;
+	};
+
+	static constexpr uint8_t twistAt(const CornerTransform& transform, uint8_t pos) { return (transform.twist >> (pos * 8)) & 0x3; }
+	static constexpr bool equal(const CornerTransform& lhs, const CornerTransform& rhs)
+	{
+		for (uint8_t i = 0; i < 8; i++)
+			if (lhs.source[i] != rhs.source[i])
+				return false;
+		return lhs.twist == rhs.twist;
+	}
+
+	// Apply first, then second
+	static constexpr CornerTransform composeTransforms(const CornerTransform& first, const CornerTransform& second)
+	{
+		CornerTransform res{};
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			uint8_t source = second.source[i];
+			res.source[i] = first.source[source];
+			res.twist |= static_cast<uint64_t>((twistAt(first, source) + twistAt(second, i)) % 3) << (i * 8);
+		}
+		return res;
+	}
+
+	// One transform per Move, indexed by the underlying value of the Move (None is the identity)
+	static constexpr std::array<CornerTransform, 19> buildMoveTables();
+
+	// anchorTables[move][anchor] is the anchor (position * 3 + orientation of WRB) after applying move
+	static constexpr std::array<std::array<uint8_t, 24>, 19> buildAnchorTables(const std::array<CornerTransform, 19>& moveTables);
+
+	// normalizationTables[anchor] is the whole-cube rotation that brings WRB from that anchor to URF with orientation 0
+	static constexpr std::array<CornerTransform, 24> buildNormalizationTables(const std::array<CornerTransform, 19>& moveTables);
+
+	// conjugationTables[anchor][move] is the move M with normalizationTables[anchor] * move = M * normalizationTables[anchor]
+	static constexpr std::array<std::array<Move, 19>, 24> buildConjugationTables(const std::array<CornerTransform, 19>& moveTables,
+		const std::array<CornerTransform, 24>& normalizationTables);
+
+	/*
+	 * The mirror image of a cube reflects it through the plane between the L and R faces. Positions (and the
+	 * pieces that belong in them) swap left and right: URF with ULF, ULB with URB, DRF with DLF, DLB with DRB,
+	 * which in the Position enum order is just i ^ 1. Clockwise becomes counterclockwise, so orientations are
+	 * negated, and a move becomes the opposite direction turn of the mirrored face (R becomes L', U becomes U').
+	 */
+	static constexpr uint8_t mirrorPosition(uint8_t pos) { return pos ^ 1; }
+	static constexpr std::array<Move, 19> buildMirrorMoves()
+	{
+		// Faces in enum order U, D, F, B, R, L; directions clockwise, counterclockwise, double
+		constexpr std::array<uint8_t, 6> mirrorFace = { 0, 1, 2, 3, 5, 4 };
+		constexpr std::array<uint8_t, 3> mirrorDirection = { 1, 0, 2 };
+		std::array<Move, 19> res{};
+		for (uint8_t m = 1; m < 19; m++)
+			res[m] = static_cast<Move>(1 + mirrorDirection[(m - 1) / 6] * 6 + mirrorFace[(m - 1) % 6]);
+		return res;
+	}
+
+	// Recoloring a cube by a rotation relabels piece p as source[p] and twists it by the rotation's twist at p.
+	// recolorTables[rotation] holds the resulting (piece << 4 | twist) byte for every piece p at byte p,
+	// in the layout of the state word, so that it can be used as a byte shuffle table.
+	static constexpr std::array<uint64_t, 24> buildRecolorTables(const std::array<CornerTransform, 24>& rotations)
+	{
+		std::array<uint64_t, 24> res{};
+		for (uint8_t r = 0; r < 24; r++)
+			for (uint8_t p = 0; p < 8; p++)
+				res[r] |= static_cast<uint64_t>((rotations[r].source[p] << 4) | twistAt(rotations[r], p)) << (p * 8);
+		return res;
+	}
+
+	/*
+	 * Facelets. A facelet string lists the 24 sticker colors face by face in the order U, R, F, D, L, B. Each face
+	 * is read left to right, top to bottom as seen from outside the cube, with U on top for the side faces, B on
+	 * top for U and F on top for D. The colors are those of the solved cube: U white, R blue, F red, D yellow,
+	 * L green, B orange.
+	 *
+	 * cornerFacelets[pos] are the indices of the 3 stickers of the corner at pos, clockwise starting from its
+	 * U or D sticker. A corner with orientation o shows its U/D color at index (3 - o) % 3 of that list.
+	 */
+	static constexpr std::array<char, 6> faceColors = { 'W', 'B', 'R', 'Y', 'G', 'O' };
+	static constexpr std::array<std::array<uint8_t, 3>, 8> cornerFacelets = { {
+		{ 3, 4, 9 }, { 2, 8, 17 }, { 0, 16, 21 }, { 1, 20, 5 },      // URF, ULF, ULB, URB
+		{ 13, 11, 6 }, { 12, 19, 10 }, { 14, 23, 18 }, { 15, 7, 22 } // DRF, DLF, DLB, DRB
+	} };
+
+	// colorIndex[c] is the index in faceColors of the color character c, or 0xFF
+	static constexpr std::array<uint8_t, 256> buildColorIndex()
+	{
+		std::array<uint8_t, 256> res{};
+		for (uint8_t& index : res)
+			index = 0xFF;
+		for (uint8_t c = 0; c < 6; c++)
+			res[static_cast<uint8_t>(faceColors[c])] = c;
+		return res;
+	}
+
+	// cornerColors[c0 * 36 + c1 * 6 + c2] is the (piece << 4 | orientation) byte of the corner that shows the
+	// color indices c0, c1, c2 clockwise from the sticker in the U or D face, or 0xFF if no corner does
+	static constexpr std::array<uint8_t, 216> buildCornerColors()
+	{
+		std::array<uint8_t, 216> res{};
+		for (uint8_t& corner : res)
+			corner = 0xFF;
+		for (uint8_t piece = 0; piece < 8; piece++)
+		{
+			// In the solved cube, every piece is in its own position and every sticker is in its own face
+			for (uint8_t ori = 0; ori < 3; ori++)
+			{
+				uint8_t k = (3 - ori) % 3;
+				std::array<uint8_t, 3> colors{};
+				for (uint8_t j = 0; j < 3; j++)
+					colors[(k + j) % 3] = cornerFacelets[piece][j] / 4;
+				res[colors[0] * 36 + colors[1] * 6 + colors[2]] = (piece << 4) | ori;
+			}
+		}
+		return res;
+	}
+
+	/*
+	 * Sticker moves, for Cube2Stickers. stickerMoveTables[move][f] is the facelet whose sticker the move brings
+	 * to facelet f. The corner at position source[i] goes to position i and its orientation grows by twist[i],
+	 * and a corner with orientation o shows its sticker j at index (3 - o + j) % 3 of cornerFacelets, so the
+	 * sticker at index k of the old position ends up at index (k - twist[i]) % 3 of the new one.
+	 * The tables are padded to 32 bytes, the size of a Cube2Stickers state, and bytes 24-31 stay in place.
+	 */
+	static constexpr std::array<std::array<uint8_t, 32>, 19> buildStickerMoveTables(const std::array<CornerTransform, 19>& moveTables)
+	{
+		std::array<std::array<uint8_t, 32>, 19> res{};
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			for (uint8_t i = 0; i < 8; i++)
+				for (uint8_t k = 0; k < 3; k++)
+					res[m][cornerFacelets[i][(k + 3 - twistAt(moveTables[m], i)) % 3]] = cornerFacelets[moveTables[m].source[i]][k];
+			for (uint8_t f = 24; f < 32; f++)
+				res[m][f] = f;
+		}
+		return res;
+	}
+
+	// The same permutations split for 16-byte shuffles: with crossing false, the bytes that come from the same
+	// half of the 32 as their destination, with crossing true those that come from the other half, and 0x80
+	// (which a byte shuffle turns into zero) for the rest
+	static constexpr std::array<std::array<uint8_t, 32>, 19> buildStickerHalfTables(const std::array<std::array<uint8_t, 32>, 19>& stickerMoveTables, bool crossing)
+	{
+		std::array<std::array<uint8_t, 32>, 19> res{};
+		for (uint8_t m = 0; m < 19; m++)
+			for (uint8_t f = 0; f < 32; f++)
+				res[m][f] = ((stickerMoveTables[m][f] ^ f) >= 16) == crossing ? stickerMoveTables[m][f] & 0x0F : 0x80;
+		return res;
+	}
+
+	// Checks on the finished tables, used by the static_asserts in Cube2Pieces.h and Cube2Stickers.h
+	static constexpr bool checkInverses(const std::array<CornerTransform, 19>& moveTables)
+	{
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			uint8_t inverse = static_cast<uint8_t>(AbstractCube::inverseMove(static_cast<Move>(m)));
+			if (!equal(composeTransforms(moveTables[m], moveTables[inverse]), moveTables[0]))
+				return false;
+		}
+		return true;
+	}
+	static constexpr bool checkNormalization(const std::array<CornerTransform, 24>& normalizationTables)
+	{
+		for (uint8_t a = 0; a < 24; a++)
+			if (transformAnchor(normalizationTables[a], a) != 0)
+				return false;
+		return true;
+	}
+	static constexpr bool checkConjugation(const std::array<std::array<Move, 19>, 24>& conjugationTables)
+	{
+		for (uint8_t m = 0; m < 19; m++)
+			if (conjugationTables[0][m] != static_cast<Move>(m))
+				return false;
+		return true;
+	}
+	static constexpr bool checkStickerInverses(const std::array<std::array<uint8_t, 32>, 19>& stickerMoveTables)
+	{
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			const auto& inverse = stickerMoveTables[static_cast<uint8_t>(AbstractCube::inverseMove(static_cast<Move>(m)))];
+			for (uint8_t f = 0; f < 32; f++)
+				if (stickerMoveTables[m][inverse[f]] != f)
+					return false;
+		}
+		return true;
+	}
+	static constexpr bool checkMirror(const std::array<Move, 19>& mirrorMoves)
+	{
+		for (uint8_t m = 0; m < 19; m++)
+			if (mirrorMoves[static_cast<uint8_t>(mirrorMoves[m])] != static_cast<Move>(m)
+				|| mirrorMoves[static_cast<uint8_t>(AbstractCube::inverseMove(static_cast<Move>(m)))] != AbstractCube::inverseMove(mirrorMoves[m]))
+				return false;
+		return true;
+	}
+
+	// The anchor that a WRB corner at the given anchor ends up at after the transform
+	static constexpr uint8_t transformAnchor(const CornerTransform& transform, uint8_t anchor)
+	{
+		for (uint8_t i = 0; i < 8; i++)
+			if (transform.source[i] == anchor / 3)
+				return i * 3 + (anchor % 3 + twistAt(transform, i)) % 3;
+		return 0xFF;
+	}
+};
+
+constexpr std::array<Cube2Tables::CornerTransform, 19> Cube2Tables::buildMoveTables()
+{
+	/*
+	 * Each quarter turn is a 4-cycle of positions: the corner at cycle[k + 1] moves into cycle[k].
+	 * After the cycle, the corner now at cycle[k] is twisted clockwise twist[k] times. Read the
+	 * preface at the top of Cube2Pieces.h for what the orientation values mean.
+	 * Note that the orientation of the pieces does not change in U/D moves.
+	 */
+	struct QuarterTurn
+	{
+		Move move;
+		std::array<Position, 4> cycle;
+		std::array<uint8_t, 4> twist;
+	};
+	constexpr std::array<QuarterTurn, 6> quarterTurns = { {
+		{ Move::U, { Position::URF, Position::URB, Position::ULB, Position::ULF }, { 0, 0, 0, 0 } },
+		{ Move::D, { Position::DRF, Position::DLF, Position::DLB, Position::DRB }, { 0, 0, 0, 0 } },
+		{ Move::F, { Position::URF, Position::ULF, Position::DLF, Position::DRF }, { 2, 1, 2, 1 } },
+		{ Move::B, { Position::URB, Position::DRB, Position::DLB, Position::ULB }, { 1, 2, 1, 2 } },
+		{ Move::R, { Position::URF, Position::DRF, Position::DRB, Position::URB }, { 1, 2, 1, 2 } },
+		{ Move::L, { Position::ULF, Position::ULB, Position::DLB, Position::DLF }, { 2, 1, 2, 1 } }
+	} };
+
+	CornerTransform identity{};
+	for (uint8_t i = 0; i < 8; i++)
+		identity.source[i] = i;
+
+	std::array<CornerTransform, 19> res{};
+	for (CornerTransform& transform : res)
+		transform = identity;
+
+	for (const QuarterTurn& quarter : quarterTurns)
+	{
+		CornerTransform turn = identity;
+		for (uint8_t k = 0; k < 4; k++)
+		{
+			uint8_t pos = static_cast<uint8_t>(quarter.cycle[k]);
+			turn.source[pos] = static_cast<uint8_t>(quarter.cycle[(k + 1) % 4]);
+			turn.twist |= static_cast<uint64_t>(quarter.twist[k]) << (pos * 8);
+		}
+		// The Move enum lists the 6 quarter turns first, then their inverses, then the double turns
+		uint8_t idx = static_cast<uint8_t>(quarter.move);
+		res[idx] = turn;
+		res[idx + 12] = composeTransforms(turn, turn);
+		res[idx + 6] = composeTransforms(res[idx + 12], turn);
+	}
+	return res;
+}
+
+constexpr std::array<std::array<uint8_t, 24>, 19> Cube2Tables::buildAnchorTables(const std::array<CornerTransform, 19>& moveTables)
+{
+	std::array<std::array<uint8_t, 24>, 19> res{};
+	for (uint8_t m = 0; m < 19; m++)
+		for (uint8_t a = 0; a < 24; a++)
+			res[m][a] = transformAnchor(moveTables[m], a);
+	return res;
+}
+
+constexpr std::array<Cube2Tables::CornerTransform, 24> Cube2Tables::buildNormalizationTables(const std::array<CornerTransform, 19>& moveTables)
+{
+	/*
+	 * Given a position and orientation of the WRB corner piece, we can rotate the cube such that WRB is in the URF position
+	 * with W in U and R in F (that is, with orientation 0). The correct rotation for a given position/orientation was
+	 * manually computed as a sequence of at most two whole-cube rotations, which we compose into a single transform here.
+	 * A whole-cube rotation is a pair of opposite face turns, see cubeRotateX etc.
+	 */
+	auto rotation = [&moveTables](Move first, Move second) {
+		return composeTransforms(moveTables[static_cast<uint8_t>(first)], moveTables[static_cast<uint8_t>(second)]);
+	};
+	const CornerTransform I = moveTables[static_cast<uint8_t>(Move::None)];
+	const CornerTransform X = rotation(Move::R, Move::Li), Xi = rotation(Move::Ri, Move::L), X2 = rotation(Move::R2, Move::L2);
+	const CornerTransform Y = rotation(Move::U, Move::Di), Yi = rotation(Move::Ui, Move::D), Y2 = rotation(Move::U2, Move::D2);
+	const CornerTransform Z = rotation(Move::F, Move::Bi), Zi = rotation(Move::Fi, Move::B), Z2 = rotation(Move::F2, Move::B2);
+
+	// Indexed by anchor, i.e. position * 3 + orientation, positions in the order of the Position enum
+	const std::array<std::pair<CornerTransform, CornerTransform>, 24> rotations = { {
+		{ I, I }, { X, Y }, { Xi, Zi },    // URF
+		{ Yi, I }, { Z, I }, { Y2, Xi },   // ULF
+		{ Y2, I }, { Yi, Z }, { Xi, Z },   // ULB
+		{ Y, I }, { Y2, Z }, { Xi, I },    // URB
+		{ X2, Y }, { Zi, I }, { X, I },    // DRF
+		{ Z2, I }, { X, Yi }, { Yi, X },   // DLF
+		{ X2, Yi }, { Y2, Zi }, { Y2, X }, // DLB
+		{ X2, I }, { Xi, Y }, { Y, X }     // DRB
+	} };
+
+	std::array<CornerTransform, 24> res{};
+	for (uint8_t a = 0; a < 24; a++)
+		res[a] = composeTransforms(rotations[a].first, rotations[a].second);
+	return res;
+}
+
+constexpr std::array<std::array<AbstractCube::Move, 19>, 24> Cube2Tables::buildConjugationTables(const std::array<CornerTransform, 19>& moveTables,
+	const std::array<CornerTransform, 24>& normalizationTables)
+{
+	// A whole-cube rotation maps every face turn to a face turn, so we just search for the matching one
+	std::array<std::array<Move, 19>, 24> res{};
+	for (uint8_t a = 0; a < 24; a++)
+	{
+		for (uint8_t m = 0; m < 19; m++)
+		{
+			CornerTransform target = composeTransforms(normalizationTables[a], moveTables[m]);
+			uint8_t match = 0;
+			while (match < 19 && !equal(composeTransforms(moveTables[match], normalizationTables[a]), target))
+				match++;
+			if (match == 19)
+				throw std::logic_error("Error: no conjugate move found while building the conjugation tables.");
+			res[a][m] = static_cast<Move>(match);
+		}
+	}
+	return res;
+}
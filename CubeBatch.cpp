@@ -0,0 +1,200 @@
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "CubeBatch.h"
+
+CubeBatch::CubeBatch(size_t count) : count(count)
+{
+	// The solved cube has piece p at position p with orientation 0
+	for (uint8_t p = 0; p < 8; p++)
+		columns[p].assign(count, static_cast<uint8_t>(p << 4));
+}
+
+CubeBatch::CubeBatch(const Cube2Pieces* cubes, size_t count)
+{
+	reserve(count);
+	for (size_t i = 0; i < count; i++)
+		push(cubes[i]);
+}
+
+void CubeBatch::clear()
+{
+	for (std::vector<uint8_t>& column : columns)
+		column.clear();
+	count = 0;
+}
+
+void CubeBatch::reserve(size_t capacity)
+{
+	for (std::vector<uint8_t>& column : columns)
+		column.reserve(capacity);
+}
+
+void CubeBatch::push(const Cube2Pieces& cube)
+{
+	for (uint8_t p = 0; p < 8; p++)
+		columns[p].push_back(static_cast<uint8_t>(cube.state >> (p * 8)));
+	count++;
+}
+
+void CubeBatch::push(const CubeBatch& other, size_t index)
+{
+	for (uint8_t p = 0; p < 8; p++)
+		columns[p].push_back(other.columns[p][index]);
+	count++;
+}
+
+Cube2Pieces CubeBatch::cube(size_t index) const
+{
+	Cube2Pieces res;
+	res.state = stateAt(index);
+	res.anchor = Cube2Pieces::findAnchor(res.state);
+	return res;
+}
+
+void CubeBatch::applyMove(Move move)
+{
+	applyTransform(Cube2Pieces::moveTables[static_cast<uint8_t>(move)]);
+}
+
+void CubeBatch::applyScramble(const Cube2Pieces::CompiledScramble& scramble)
+{
+	applyTransform(scramble.transform);
+}
+
+void CubeBatch::hashes(uint64_t* out) const
+{
+	gatherStates(out);
+	for (size_t i = 0; i < count; i++)
+		out[i] = Cube2Pieces::canonicalKeyOf(out[i], Cube2Pieces::findAnchor(out[i]));
+}
+
+void CubeBatch::coordinates(uint16_t* permutations, uint16_t* orientations) const
+{
+	std::vector<uint64_t> keys(count);
+	hashes(keys.data());
+	for (size_t i = 0; i < count; i++)
+	{
+		permutations[i] = Cube2Pieces::keyToPermutationIndex(keys[i]);
+		orientations[i] = Cube2Pieces::keyToOrientationIndex(keys[i]);
+	}
+}
+
+void CubeBatch::stateIndices(uint32_t* out) const
+{
+	std::vector<uint64_t> keys(count);
+	hashes(keys.data());
+	for (size_t i = 0; i < count; i++)
+		out[i] = Cube2Pieces::keyToStateIndex(keys[i]);
+}
+
+/*
+ * Private member functions
+*/
+
+void CubeBatch::applyTransform(const CornerTransform& transform)
+{
+	// The corners that end up at position p are the ones at source[p], so column p is the old column source[p]
+	std::array<std::vector<uint8_t>, 8> permuted;
+	for (uint8_t p = 0; p < 8; p++)
+		permuted[p] = std::move(columns[transform.source[p]]);
+	columns = std::move(permuted);
+
+	for (uint8_t p = 0; p < 8; p++)
+	{
+		uint8_t twist = Cube2Tables::twistAt(transform, p);
+		if (twist != 0)
+			twistColumn(columns[p].data(), count, twist);
+	}
+}
+
+void CubeBatch::twistColumn(uint8_t* column, size_t count, uint8_t twist)
+{
+	size_t i = 0;
+#if defined(__SSSE3__)
+	// A byte shuffle on the low nibbles maps every orientation o to (o + twist) % 3, as in Cube2Pieces::applyTransformSimd
+	const __m128i table = twist == 1 ? _mm_setr_epi8(1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+		: _mm_setr_epi8(2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+#if defined(__AVX2__)
+	const __m256i wideTable = _mm256_broadcastsi128_si256(table);
+	const __m256i wideLowNibble = _mm256_set1_epi8(0x0F);
+	for (; i + 32 <= count; i += 32)
+	{
+		__m256i corners = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column + i));
+		__m256i orientations = _mm256_shuffle_epi8(wideTable, _mm256_and_si256(corners, wideLowNibble));
+		corners = _mm256_or_si256(_mm256_andnot_si256(wideLowNibble, corners), orientations);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(column + i), corners);
+	}
+#endif
+	const __m128i lowNibble = _mm_set1_epi8(0x0F);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i corners = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + i));
+		__m128i orientations = _mm_shuffle_epi8(table, _mm_and_si128(corners, lowNibble));
+		corners = _mm_or_si128(_mm_andnot_si128(lowNibble, corners), orientations);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(column + i), corners);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		uint8_t orientation = (column[i] & 0x3) + twist;
+		column[i] = (column[i] & 0xF0) | (orientation >= 3 ? orientation - 3 : orientation);
+	}
+}
+
+uint64_t CubeBatch::stateAt(size_t index) const
+{
+	uint64_t state = 0;
+	for (uint8_t p = 0; p < 8; p++)
+		state |= static_cast<uint64_t>(columns[p][index]) << (p * 8);
+	return state;
+}
+
+void CubeBatch::gatherStates(uint64_t* out) const
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	// Transpose 16 cubes at a time: interleave the columns byte by byte, then the pairs of bytes, then the halves
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i c[8];
+		for (uint8_t p = 0; p < 8; p++)
+			c[p] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns[p].data() + i));
+
+		__m128i pairs[8]; // bytes 2k and 2k + 1 of cubes 0-7, then of cubes 8-15
+		for (uint8_t k = 0; k < 4; k++)
+		{
+			pairs[k] = _mm_unpacklo_epi8(c[2 * k], c[2 * k + 1]);
+			pairs[k + 4] = _mm_unpackhi_epi8(c[2 * k], c[2 * k + 1]);
+		}
+		// halves[4 * g + 2 * r] holds bytes 0-3 and halves[4 * g + 2 * r + 1] bytes 4-7 of cubes 8g + 4r to 8g + 4r + 3
+		__m128i halves[8];
+		for (uint8_t g = 0; g < 2; g++)
+		{
+			for (uint8_t k = 0; k < 2; k++)
+			{
+				halves[g * 4 + k] = _mm_unpacklo_epi16(pairs[g * 4 + 2 * k], pairs[g * 4 + 2 * k + 1]);
+				halves[g * 4 + k + 2] = _mm_unpackhi_epi16(pairs[g * 4 + 2 * k], pairs[g * 4 + 2 * k + 1]);
+			}
+		}
+		for (uint8_t q = 0; q < 4; q++)
+		{
+			const __m128i& low = halves[2 * q];
+			const __m128i& high = halves[2 * q + 1];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + q * 4), _mm_unpacklo_epi32(low, high));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + q * 4 + 2), _mm_unpackhi_epi32(low, high));
+		}
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = stateAt(i);
+}
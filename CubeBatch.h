@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Cube2Pieces.h"
+
+/* ----------------------------------------------------------------------------
+ * A batch of 2x2x2 states stored column-wise, for table generation and other
+ * passes over many states at once.
+ *
+ * Column p holds the corner byte at position p of every cube in the batch,
+ * in the same layout as the bytes of Cube2Pieces::state. A move sends the
+ * corner at position source[p] to position p and twists it, so applying one
+ * to the whole batch reorders the 8 columns, which only swaps their buffers,
+ * and then adds the twists to the columns that need them, 16 or 32 cubes per
+ * instruction. U and D turns do not twist any corner and cost nothing per
+ * cube at all.
+ *
+ * The batch holds states only: no previous move, and anchors and canonical
+ * keys are computed when they are extracted.
+ * --------------------------------------------------------------------------
+*/
+class CubeBatch
+{
+public:
+	using Move = AbstractCube::Move;
+
+	// count solved cubes
+	explicit CubeBatch(size_t count = 0);
+	CubeBatch(const Cube2Pieces* cubes, size_t count);
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	void clear();
+	void reserve(size_t capacity);
+
+	void push(const Cube2Pieces& cube);
+	// Append the cube at the given index of another batch
+	void push(const CubeBatch& other, size_t index);
+	Cube2Pieces cube(size_t index) const;
+
+	// Apply the same move, or compiled sequence of moves, to every cube in the batch
+	void applyMove(Move move);
+	void applyScramble(const Cube2Pieces::CompiledScramble& scramble);
+
+	// Bulk extraction: out must have room for size() values. hashes gives Cube2Pieces::cubeHash
+	// (the canonical key) of every cube, the others its coordinates, see Cube2Pieces::stateIndex.
+	void hashes(uint64_t* out) const;
+	void coordinates(uint16_t* permutations, uint16_t* orientations) const;
+	void stateIndices(uint32_t* out) const;
+
+private:
+	using CornerTransform = Cube2Tables::CornerTransform;
+
+	std::array<std::vector<uint8_t>, 8> columns;
+	size_t count = 0;
+
+	void applyTransform(const CornerTransform& transform);
+	// Add twist (1 or 2) to the orientation in every byte of the column, mod 3
+	static void twistColumn(uint8_t* column, size_t count, uint8_t twist);
+	// The state word of the cube at the given index, or of every cube
+	uint64_t stateAt(size_t index) const;
+	void gatherStates(uint64_t* out) const;
+};
@@ -5,181 +5,419 @@
 #include <algorithm>
 #include <stdexcept>
 #include <filesystem>
+#include <vector>
+#include <array>
+#include <cstring>
 
 #include "Heuristic.h"
 #include "Cube2Pieces.h"
+#include "CubeBatch.h"
 
 // Static member initialization
-std::unordered_map<uint64_t, uint16_t> Heuristic::orientationLookup;
-std::unordered_map<uint64_t, uint16_t> Heuristic::permutationLookup;
-std::unordered_map<uint64_t, uint16_t> Heuristic::perfectLookup;
+const uint8_t* Heuristic::orientationLookup = nullptr;
+const uint8_t* Heuristic::permutationLookup = nullptr;
+const uint8_t* Heuristic::perfectLookup = nullptr;
+MappedFile Heuristic::orientationFile;
+MappedFile Heuristic::permutationFile;
+MappedFile Heuristic::perfectFile;
+SymmetryClassTable Heuristic::perfectSymmetryLookup;
 
-// Base class functions
-void Heuristic::initOrientationLookup()
-{
-	if (std::filesystem::exists("orientationLookup.txt"))
-		readLookupFromFile(orientationLookup, "orientationLookup.txt");
-	else {
-		generateLookupTable(orientationLookup, &Cube2Pieces::orientationHash);
-		writeLookupToFile(orientationLookup, "orientationLookup.txt");
-		readLookupFromFile(orientationLookup, "orientationLookup.txt");
-	}
-}
+const Heuristic::Layout Heuristic::orientationLayout = { 1, Cube2Pieces::numOrientations, 1, 24 };
+const Heuristic::Layout Heuristic::permutationLayout = { 2, Cube2Pieces::numPermutations, Cube2Pieces::numOrientations, 0 };
+const Heuristic::Layout Heuristic::perfectLayout = { 3, Cube2Pieces::numStates, 1, 0 };
 
-void Heuristic::initPermutationLookup()
+// The metric recorded in the lookup files: the axial tables are the HTM tables
+static uint8_t fileMetric(AbstractCube::Metric metric)
 {
-	if (std::filesystem::exists("permutationLookup.txt"))
-		readLookupFromFile(permutationLookup, "permutationLookup.txt");
-	else {
-		generateLookupTable(permutationLookup, &Cube2Pieces::permutationHash);
-		writeLookupToFile(permutationLookup, "permutationLookup.txt");
-		readLookupFromFile(permutationLookup, "permutationLookup.txt");
-	}
+	return static_cast<uint8_t>(metric == AbstractCube::Metric::QTM ? AbstractCube::Metric::QTM : AbstractCube::Metric::HTM);
 }
 
-void Heuristic::initPerfectLookup()
+// Lookup file functions
+bool LookupFileHeader::write(const std::string& filename, AbstractCube::Metric metric, uint8_t scheme, uint8_t entryBits,
+	uint32_t entryCount, const uint8_t* payload, size_t payloadSize)
 {
-	if (std::filesystem::exists("perfectLookup.txt"))
-		readLookupFromFile(perfectLookup, "perfectLookup.txt");
-	else {
-		generateLookupTable(perfectLookup, &Cube2Pieces::cubeHash);
-		writeLookupToFile(perfectLookup, "perfectLookup.txt");
-		readLookupFromFile(perfectLookup, "perfectLookup.txt");
+	if (std::filesystem::exists(filename))
+		return false;
+
+	LookupFileHeader header{};
+	std::copy(std::begin(fileMagic), std::end(fileMagic), header.magic);
+	header.version = fileVersion;
+	header.metric = fileMetric(metric);
+	header.scheme = scheme;
+	header.entryBits = entryBits;
+	header.entryCount = entryCount;
+	header.checksum = computeChecksum(payload, payloadSize);
+
+	// If another process renames its file into place between the check above and the rename below, the rename
+	// replaces a complete table with an identical one, and processes that mapped the old file keep their mapping
+	std::string temporary = temporaryFilename(filename);
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw std::runtime_error("Error: LookupFileHeader::write could not open the file for writing: " + temporary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(payload), payloadSize);
+	file.close();
+	if (!file)
+	{
+		std::filesystem::remove(temporary);
+		throw std::runtime_error("Error: LookupFileHeader::write could not write to the file: " + temporary);
 	}
+	std::filesystem::rename(temporary, filename);
+	return true;
 }
 
-void Heuristic::generateLookupTable(std::unordered_map<uint64_t, uint16_t>& lookup, uint32_t(Cube2Pieces::* hashFunction)() const)
+LookupFileHeader LookupFileHeader::map(MappedFile& file, const std::string& filename, AbstractCube::Metric metric, uint8_t scheme, uint8_t entryBits)
 {
-	std::queue<std::pair<std::unique_ptr<AbstractCube>, uint16_t>> q; // BFS queue with depth.
-	q.emplace(std::make_pair(std::make_unique<Cube2Pieces>(), 0)); // Use emplace 
-	uint16_t searchDepth = 0;
+	if (filename.empty())
+		throw std::invalid_argument("Error: LookupFileHeader::map called with an empty filename.");
+	if (!std::filesystem::exists(filename))
+		throw std::runtime_error("Error: LookupFileHeader::map called with a filename that does not exist: " + filename);
+	MappedFile mapped(filename);
 
-	std::cout << "Generating lookup table..." << std::endl;
-	while (!q.empty())
-	{
-		const auto& [current, depth] = std::move(q.front()); // use move semantics to avoid copying.
-		if (!current)
-			throw std::runtime_error("Error: generateLookupTable encountered a null pointer.");
+	// Check everything the header says before trusting the payload. Deleting a bad file makes the next run regenerate it.
+	LookupFileHeader header{};
+	if (mapped.size() < sizeof(header))
+		throw std::runtime_error("Error: LookupFileHeader::map found a file of the wrong size: " + filename);
+	std::memcpy(&header, mapped.data(), sizeof(header));
+	if (!std::equal(std::begin(fileMagic), std::end(fileMagic), header.magic))
+		throw std::runtime_error("Error: LookupFileHeader::map found a file that is not a lookup table: " + filename);
+	if (header.version != fileVersion)
+		throw std::runtime_error("Error: LookupFileHeader::map found an unsupported lookup file version in " + filename);
+	if (header.metric != fileMetric(metric) || header.scheme != scheme || header.entryBits != entryBits)
+		throw std::runtime_error("Error: LookupFileHeader::map found a lookup file for a different table: " + filename);
+	if (computeChecksum(mapped.data() + sizeof(header), mapped.size() - sizeof(header)) != header.checksum)
+		throw std::runtime_error("Error: LookupFileHeader::map found a corrupted lookup file (checksum mismatch): " + filename);
+	file = std::move(mapped);
+	return header;
+}
 
-		auto* currentRaw = dynamic_cast<Cube2Pieces*>(current.get());
-		if (!currentRaw)
-			throw std::runtime_error("Error: generateLookupTable encountered a null pointer.");
+uint64_t LookupFileHeader::computeChecksum(const uint8_t* data, size_t size)
+{
+	// 64-bit FNV-1a
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 0x100000001B3ULL;
+	return hash;
+}
 
-		if (depth > searchDepth)
-		{
-			std::cout << "Depth: " << searchDepth << std::endl;
-			searchDepth = depth;
-		}
+// Symmetry class table functions
+void SymmetryClassTable::generate(AbstractCube::Metric metric)
+{
+	std::unordered_map<uint64_t, uint8_t> classDistances;
+	std::queue<std::pair<Cube2Pieces, uint8_t>> q; // BFS queue with depth, one cube per class
+	q.emplace(Cube2Pieces(), 0);
+	classDistances[q.front().first.symmetryHash()] = 0;
+	SuccessorBuffer<Cube2Pieces> successors;
 
-		// TODO: switch order -- be consist with 64 bit version
-		uint64_t hash = (currentRaw->*hashFunction)();
-		if (lookup.find(hash) == lookup.end())
+	std::cout << "Generating symmetry class table..." << std::endl;
+	while (!q.empty())
+	{
+		const auto& [current, depth] = q.front();
+		// Cubes in the same class are the same distance from solved, so expanding one of them is enough.
+		// The search starts from the solved cube, so the fixed-corner moves reach every class.
+		current.getFixedCornerSuccessors(successors, metric);
+		for (const auto& successor : successors)
 		{
-			lookup[hash] = depth;
-			for (auto& child : current->getNextMoves())
-				q.emplace(std::move(child), depth + 1); // Emplace again
+			uint64_t hash = successor.cube.symmetryHash();
+			if (classDistances.find(hash) == classDistances.end())
+			{
+				classDistances[hash] = depth + 1;
+				q.emplace(successor.cube, depth + 1);
+			}
 		}
 		q.pop();
 	}
+	build(classDistances);
 }
 
-void Heuristic::generateLookupTable(std::unordered_map<uint64_t, uint16_t>& lookup, uint64_t(Cube2Pieces::* hashFunction)() const)
+void SymmetryClassTable::build(const std::unordered_map<uint64_t, uint8_t>& classDistances)
 {
-	std::queue<std::pair<std::unique_ptr<AbstractCube>, uint16_t>> q; // BFS queue with depth.
-	q.emplace(std::make_pair(std::make_unique<Cube2Pieces>(), 0)); // Use emplace 
-	uint16_t searchDepth = 0;
+	// Sort the classes by (permutation, orientation) of their representative
+	std::vector<std::pair<uint32_t, uint8_t>> classes;
+	classes.reserve(classDistances.size());
+	for (const auto& [hash, depth] : classDistances)
+	{
+		if (depth > 0xF)
+			throw std::runtime_error("Error: symmetry class distance does not fit in 4 bits.");
+		uint32_t coordinates = (static_cast<uint32_t>(Cube2Pieces::keyToPermutationIndex(hash)) << 16) | Cube2Pieces::keyToOrientationIndex(hash);
+		classes.emplace_back(coordinates, depth);
+	}
+	std::sort(classes.begin(), classes.end());
 
-	std::cout << "Generating lookup table..." << std::endl;
-	while (!q.empty())
+	offsetStorage.assign(Cube2Pieces::numPermutations + 1, 0);
+	orientationStorage.resize(classes.size());
+	distanceStorage.assign((classes.size() + 1) / 2, 0);
+	for (uint32_t i = 0; i < classes.size(); i++)
 	{
-		const auto& [current, depth] = std::move(q.front()); // use move semantics to avoid copying.
+		offsetStorage[(classes[i].first >> 16) + 1]++;
+		orientationStorage[i] = classes[i].first & 0xFFFF;
+		distanceStorage[i / 2] |= classes[i].second << ((i % 2) * 4);
+	}
+	for (uint16_t p = 0; p < Cube2Pieces::numPermutations; p++)
+		offsetStorage[p + 1] += offsetStorage[p];
 
-		if (!current)
-			throw std::runtime_error("Error: generateLookupTable encountered a null pointer.");
+	file = MappedFile();
+	offsets = offsetStorage.data();
+	orientations = orientationStorage.data();
+	distances = distanceStorage.data();
+	classCount = static_cast<uint32_t>(classes.size());
+}
 
-		auto* currentRaw = dynamic_cast<Cube2Pieces*>(current.get());
-		if (!currentRaw)
-			throw std::runtime_error("Error: generateLookupTable encountered a null pointer.");
+void SymmetryClassTable::writeToFile(const std::string& filename, AbstractCube::Metric metric) const
+{
+	if (classCount == 0)
+		throw std::invalid_argument("Error: writeToFile called with an empty symmetry class table.");
 
-		if (depth > searchDepth)
-		{
-			std::cout << "Depth: " << searchDepth << std::endl;
-			searchDepth = depth;
-		}
+	size_t offsetBytes = (Cube2Pieces::numPermutations + 1) * sizeof(uint32_t);
+	size_t orientationBytes = classCount * sizeof(uint16_t);
+	std::vector<uint8_t> payload(offsetBytes + orientationBytes + (classCount + 1) / 2);
+	std::memcpy(payload.data(), offsets, offsetBytes);
+	std::memcpy(payload.data() + offsetBytes, orientations, orientationBytes);
+	std::memcpy(payload.data() + offsetBytes + orientationBytes, distances, (classCount + 1) / 2);
+
+	std::cout << "Writing " << size() << " entries to " << filename << std::endl;
+	if (LookupFileHeader::write(filename, metric, fileScheme, 4, size(), payload.data(), payload.size()))
+		std::cout << "Finished writing to " << filename << std::endl;
+	else
+		std::cout << filename << " already exists, keeping it" << std::endl;
+}
+
+void SymmetryClassTable::readFromFile(const std::string& filename, AbstractCube::Metric metric)
+{
+	std::cout << "Mapping " << filename << std::endl;
+	MappedFile mapped;
+	LookupFileHeader header = LookupFileHeader::map(mapped, filename, metric, fileScheme, 4);
+	uint32_t count = header.entryCount;
+	size_t offsetBytes = (Cube2Pieces::numPermutations + 1) * sizeof(uint32_t);
+	size_t orientationBytes = count * sizeof(uint16_t);
+	if (count != numClasses || mapped.size() != sizeof(header) + offsetBytes + orientationBytes + (count + 1) / 2)
+		throw std::runtime_error("Error: readFromFile found a symmetry class table of the wrong size: " + filename);
+
+	// The header is 32 bytes and the offsets take a multiple of 4, so every array is aligned for its type
+	const uint8_t* payload = mapped.data() + sizeof(header);
+	const uint32_t* mappedOffsets = reinterpret_cast<const uint32_t*>(payload);
+	if (mappedOffsets[Cube2Pieces::numPermutations] != count)
+		throw std::runtime_error("Error: readFromFile found inconsistent offsets in " + filename);
+
+	file = std::move(mapped);
+	offsetStorage.clear();
+	orientationStorage.clear();
+	distanceStorage.clear();
+	offsets = mappedOffsets;
+	orientations = reinterpret_cast<const uint16_t*>(payload + offsetBytes);
+	distances = payload + offsetBytes + orientationBytes;
+	classCount = count;
+}
+
+void SymmetryClassTable::readFromTextFile(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+		throw std::runtime_error("Error: readFromTextFile could not open the file for reading: " + filename);
+
+	std::cout << "Converting " << filename << " to the binary format" << std::endl;
+	std::unordered_map<uint64_t, uint8_t> classDistances;
+	uint64_t hash;
+	uint16_t depth;
+	while (file >> hash >> depth)
+		classDistances[hash] = static_cast<uint8_t>(depth);
+	if (classDistances.size() != numClasses)
+		throw std::runtime_error("Error: readFromTextFile found an incomplete symmetry class table in " + filename);
+	build(classDistances);
+}
+
+uint32_t SymmetryClassTable::classIndex(const Cube2Pieces& cube) const
+{
+	uint64_t hash = cube.symmetryHash();
+	uint16_t perm = Cube2Pieces::keyToPermutationIndex(hash);
+	uint16_t ori = Cube2Pieces::keyToOrientationIndex(hash);
+
+	const uint16_t* first = orientations + offsets[perm];
+	const uint16_t* last = orientations + offsets[perm + 1];
+	const uint16_t* it = std::lower_bound(first, last, ori);
+	if (it == last || *it != ori)
+		throw std::runtime_error("Error: cube not found in the symmetry class table.");
+	return static_cast<uint32_t>(it - orientations);
+}
+
+uint8_t SymmetryClassTable::distance(const Cube2Pieces& cube) const
+{
+	uint32_t index = classIndex(cube);
+	return (distances[index / 2] >> ((index % 2) * 4)) & 0xF;
+}
+
+// Base class functions
+std::string Heuristic::lookupFilename(const std::string& name, AbstractCube::Metric metric, const std::string& extension)
+{
+	// Axial distances are the HTM distances, so the two metrics share the original file names
+	if (metric == AbstractCube::Metric::QTM)
+		return name + "QTM" + extension;
+	return name + extension;
+}
+
+void Heuristic::initOrientationLookup(AbstractCube::Metric metric)
+{
+	orientationLookup = initLookup(orientationFile, orientationLayout, "orientationLookup", metric);
+}
+
+void Heuristic::initPermutationLookup(AbstractCube::Metric metric)
+{
+	permutationLookup = initLookup(permutationFile, permutationLayout, "permutationLookup", metric);
+}
+
+void Heuristic::initPerfectLookup(AbstractCube::Metric metric)
+{
+	perfectLookup = initLookup(perfectFile, perfectLayout, "perfectLookup", metric);
+}
+
+const uint8_t* Heuristic::initLookup(MappedFile& file, const Layout& layout, const std::string& name, AbstractCube::Metric metric)
+{
+	std::string filename = lookupFilename(name, metric);
+	if (!std::filesystem::exists(filename))
+	{
+		std::vector<uint8_t> lookup(layout.size);
+		std::string textFilename = lookupFilename(name, metric, ".txt");
+		if (std::filesystem::exists(textFilename))
+			readLookupFromTextFile(lookup.data(), layout, textFilename);
+		else
+			generateLookupTable(lookup.data(), layout, metric);
+		writeLookupToFile(lookup.data(), layout, metric, filename);
+	}
+	return readLookupFromFile(file, layout, metric, filename);
+}
+
+void Heuristic::initPerfectSymmetryLookup(AbstractCube::Metric metric)
+{
+	std::string filename = lookupFilename("perfectSymmetryLookup", metric);
+	if (!std::filesystem::exists(filename))
+	{
+		std::string textFilename = lookupFilename("perfectSymmetryLookup", metric, ".txt");
+		if (std::filesystem::exists(textFilename))
+			perfectSymmetryLookup.readFromTextFile(textFilename);
+		else
+			perfectSymmetryLookup.generate(metric);
+		perfectSymmetryLookup.writeToFile(filename, metric);
+	}
+	perfectSymmetryLookup.readFromFile(filename, metric);
+}
+
+void Heuristic::generateLookupTable(uint8_t* lookup, const Layout& layout, AbstractCube::Metric metric)
+{
+	// BFS one depth at a time: every move is applied to a whole batch of cubes at once, then the new entries are kept.
+	// The frontier is split by the previous move recorded for its cubes, so that each part only gets the moves that
+	// may follow it. Every cube is normalized, so the fixed-corner moves are enough.
+	std::array<CubeBatch, 19> frontier;
+	frontier[static_cast<uint8_t>(AbstractCube::Move::None)] = CubeBatch(1);
+	std::fill(lookup, lookup + layout.size, unknownDistance);
+	lookup[layout.indexOf(Cube2Pieces().stateIndex())] = 0;
+	std::vector<uint32_t> indices;
 
-		for (auto& child : current->getNextMoves())
+	std::cout << "Generating lookup table..." << std::endl;
+	for (uint16_t depth = 0; std::any_of(frontier.begin(), frontier.end(), [](const CubeBatch& batch) { return !batch.empty(); }); depth++)
+	{
+		std::cout << "Depth: " << depth << std::endl;
+		std::array<CubeBatch, 19> next;
+		for (uint8_t prev = 0; prev < 19; prev++)
 		{
-			auto* childRaw = dynamic_cast<Cube2Pieces*>(child.get());
-			if (!childRaw)
-				throw std::runtime_error("Error: generateLookupTable encountered a null pointer.");
-			uint64_t hash = (childRaw->*hashFunction)();
-			if (lookup.find(hash) == lookup.end())
+			const CubeBatch& parents = frontier[prev];
+			indices.resize(parents.size());
+			for (AbstractCube::Move move : Cube2Pieces::fixedCornerMoves)
 			{
-				lookup[hash] = depth + 1;
-				q.emplace(std::move(child), depth + 1); // Emplace again
+				if (parents.empty() || !AbstractCube::isMoveAllowed(static_cast<AbstractCube::Move>(prev), move, metric))
+					continue;
+				CubeBatch children = parents;
+				children.applyMove(move);
+				children.stateIndices(indices.data());
+				CubeBatch& recorded = next[static_cast<uint8_t>(AbstractCube::recordedMove(static_cast<AbstractCube::Move>(prev), move))];
+				for (size_t i = 0; i < children.size(); i++)
+				{
+					uint8_t& entry = lookup[layout.indexOf(indices[i])];
+					if (entry == unknownDistance)
+					{
+						entry = static_cast<uint8_t>(depth + 1);
+						recorded.push(children, i);
+					}
+				}
 			}
 		}
-		q.pop();
+		frontier = std::move(next);
 	}
 }
 
-void Heuristic::writeLookupToFile(const std::unordered_map<uint64_t, uint16_t>&lookup, const std::string & filename)
+void Heuristic::writeLookupToFile(const uint8_t* lookup, const Layout& layout, AbstractCube::Metric metric, const std::string& filename)
 {
-	if (lookup.empty())
-		throw std::invalid_argument("Error: writeLookupToFile called with an empty lookup table");
+	if (std::find(lookup, lookup + layout.size, unknownDistance) != lookup + layout.size)
+		throw std::invalid_argument("Error: writeLookupToFile called with an incomplete lookup table");
 	if (filename.empty())
 		throw std::invalid_argument("Error: writeLookupToFile called with an empty filename.");
-	if (std::filesystem::exists(filename))
-		throw std::runtime_error("Error: writeLookupToFile called with a filename that already exists: " + filename);
-
-	std::ofstream file(filename);
-	if (!file)
-		throw std::runtime_error("Error: writeLookupToFile could not open the file for writing: " + filename);
 
-	std::cout << "Writing " << lookup.size() << " entries to " << filename << std::endl;
-	for (const auto& [hash, depth] : lookup)
-		file << hash << " " << depth << std::endl;
-	std::cout << "Finished writing to " << filename << std::endl;
-	file.close();
+	std::cout << "Writing " << layout.size << " entries to " << filename << std::endl;
+	if (LookupFileHeader::write(filename, metric, layout.scheme, 8, layout.size, lookup, layout.size))
+		std::cout << "Finished writing to " << filename << std::endl;
+	else
+		std::cout << filename << " already exists, keeping it" << std::endl;
 }
 
-void Heuristic::readLookupFromFile(std::unordered_map<uint64_t, uint16_t>& lookup, const std::string& filename)
+const uint8_t* Heuristic::readLookupFromFile(MappedFile& file, const Layout& layout, AbstractCube::Metric metric, const std::string& filename)
 {
-	if (filename.empty())
-		throw std::invalid_argument("Error: readLookupFromFile called with an empty filename.");
-	if (!std::filesystem::exists(filename))
-		throw std::runtime_error("Error: readLookupFromFile called with a filename that does not exist: " + filename);
+	std::cout << "Mapping " << filename << std::endl;
+	MappedFile mapped;
+	LookupFileHeader header = LookupFileHeader::map(mapped, filename, metric, layout.scheme, 8);
+	if (header.entryCount != layout.size || mapped.size() != sizeof(header) + layout.size)
+		throw std::runtime_error("Error: readLookupFromFile found a lookup file of the wrong size: " + filename);
+	file = std::move(mapped);
+	return file.data() + sizeof(header);
+}
 
+void Heuristic::readLookupFromTextFile(uint8_t* lookup, const Layout& layout, const std::string& filename)
+{
 	std::ifstream file(filename);
 	if (!file)
-		throw std::runtime_error("Error: readLookupFromFile could not open the file for reading: " + filename);
+		throw std::runtime_error("Error: readLookupFromTextFile could not open the file for reading: " + filename);
 
-	std::cout << "Reading from " << filename << std::endl;
+	std::cout << "Converting " << filename << " to the binary format" << std::endl;
+	std::fill(lookup, lookup + layout.size, unknownDistance);
 	uint64_t hash;
 	uint16_t depth;
 	while (file >> hash >> depth)
-		lookup[hash] = depth;
-	std::cout << "Finished reading from " << filename << std::endl;
+	{
+		if (depth >= unknownDistance)
+			throw std::runtime_error("Error: readLookupFromTextFile found a distance out of range in " + filename);
+		lookup[layout.indexOf(Cube2Pieces::keyToStateIndex(hash << layout.hashShift))] = static_cast<uint8_t>(depth);
+	}
+	// A table with holes would give wrong (and maybe inadmissible) heuristics, so refuse it
+	if (std::find(lookup, lookup + layout.size, unknownDistance) != lookup + layout.size)
+		throw std::runtime_error("Error: readLookupFromTextFile found an incomplete lookup table in " + filename);
 	file.close();
 }
 
 // Specific heuristics
 uint16_t OrientationHeuristic::heuristic(const Cube2Pieces& cube) const
 {
-	return orientationLookup[cube.orientationHash()];
+	return orientationLookup[cube.orientationIndex()];
 }
 
 uint16_t PermutationHeuristic::heuristic(const Cube2Pieces& cube) const
 {
-	return permutationLookup[cube.permutationHash()];
+	return permutationLookup[cube.permutationIndex()];
 }
 
 uint16_t DualHeuristic::heuristic(const Cube2Pieces& cube) const
 {
-	return std::max(orientationLookup[cube.orientationHash()], permutationLookup[cube.permutationHash()]);
+	return std::max(orientationLookup[cube.orientationIndex()], permutationLookup[cube.permutationIndex()]);
 }
 
 uint16_t PerfectHeuristic::heuristic(const Cube2Pieces& cube) const
 {
-	return perfectLookup[cube.cubeHash()];
+	return perfectLookup[cube.stateIndex()];
+}
+
+uint16_t PerfectSymmetryHeuristic::heuristic(const Cube2Pieces& cube) const
+{
+	return perfectSymmetryLookup.distance(cube);
+}
+
+uint16_t InverseMaxHeuristic::heuristic(const Cube2Pieces& cube) const
+{
+	return std::max(base.heuristic(cube), base.heuristic(cube.inverse()));
 }
@@ -4,8 +4,10 @@
 #include <fstream>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "Cube2Pieces.h"
+#include "utils.h"
 
 /* ----------------------------------------------------------------------------
  * This file contains the definition for the Heuristic class.
@@ -17,35 +19,159 @@
  * We precompute our heuristic and store it in a lookup table. This lookup
  * table is generated by performing a breadth first search on the 2x2x2 cube.
  *
- * Once we have our lookup tables, at program initialization we read the 
- * heuristics into a map. This map should not change for the program lifetime.
- * Hence the heuristic function is a static member function.
+ * Once we have our lookup tables, at program initialization we map the
+ * lookup files read-only into memory (see MappedFile). The tables are flat
+ * arrays indexed by the coordinates of the cube (see Cube2Pieces::stateIndex),
+ * one byte per entry: 729 entries for the orientations, 5040 for the
+ * permutations and 3,674,160 for the perfect table. A heuristic is then a
+ * single load, and startup only checks the headers and checksums, with no
+ * parsing or copying. These tables should not change for the program
+ * lifetime. Hence the heuristic function is a static member function.
  * 
- * In the future this class should be extended to verify the integrity of the
- * lookup files before reading them into memory.
+ * The lookup files are binary: a 32-byte header (see LookupFileHeader)
+ * followed by the entries in index order. The header records what the entries mean and
+ * a checksum of them, and a file that does not match the table being loaded
+ * is refused instead of read. Older versions wrote "hash depth" text lines
+ * to .txt files; those are converted to the binary format the first time
+ * they are read.
+ *
+ * Distances depend on the turn metric (see AbstractCube::Metric), so every
+ * table is generated for a metric and has a file per metric. The axial metric
+ * has the same distances as HTM on the 2x2x2, so it shares the HTM files.
+ * --------------------------------------------------------------------------
+*/
+
+/* ----------------------------------------------------------------------------
+ * The header of the binary lookup files, followed by the payload of the
+ * table. It is written in the byte order of the machine that wrote it.
+ * --------------------------------------------------------------------------
+*/
+struct LookupFileHeader
+{
+	char magic[8];
+	uint16_t version;
+	uint8_t metric;      // AbstractCube::Metric of the distances (HTM for the axial metric)
+	uint8_t scheme;      // Which table the payload holds, i.e. how it is indexed
+	uint8_t entryBits;   // Bits per distance
+	uint8_t reserved[3];
+	uint32_t entryCount; // Number of distances
+	uint32_t reserved2;
+	uint64_t checksum;   // FNV-1a of the payload
+
+	static constexpr char fileMagic[8] = { 'C', 'U', 'B', 'E', '2', 'P', 'D', 'B' };
+	static constexpr uint16_t fileVersion = 1;
+
+	// Write the header of the given table and its payload. The file is written under a temporary name of
+	// its own (see temporaryFilename) and renamed into place, so that no process ever maps a partial table,
+	// even with several processes generating the same one. Returns false, without writing, if the file
+	// already exists, e.g. because another process generated the same table first.
+	static bool write(const std::string& filename, AbstractCube::Metric metric, uint8_t scheme, uint8_t entryBits,
+		uint32_t entryCount, const uint8_t* payload, size_t payloadSize);
+	// Map the file and check that it holds the given kind of table in the given metric and that its payload
+	// matches the checksum. The payload starts at file.data() + sizeof(LookupFileHeader); its size is for the
+	// caller to check against entryCount. Throws std::runtime_error, and leaves file untouched, on a bad file.
+	static LookupFileHeader map(MappedFile& file, const std::string& filename, AbstractCube::Metric metric, uint8_t scheme, uint8_t entryBits);
+	static uint64_t computeChecksum(const uint8_t* data, size_t size);
+};
+static_assert(sizeof(LookupFileHeader) == 32, "The lookup file header must have no padding");
+
+/* ----------------------------------------------------------------------------
+ * Perfect distances stored per symmetry class (see Cube2Pieces::symmetryHash)
+ * instead of per state: 77,802 entries instead of 3,674,160.
+ *
+ * A class is identified by the permutation and orientation coordinates of its
+ * representative. The orientations of the representatives are stored sorted
+ * and grouped by permutation, so the index of a class is the offset of its
+ * permutation plus a binary search over a few dozen orientations. Distances
+ * take 4 bits each. The whole table is about 200KB, so it stays in L2.
  * --------------------------------------------------------------------------
 */
+class SymmetryClassTable
+{
+public:
+	// BFS over the symmetry classes, starting from the solved cube
+	void generate(AbstractCube::Metric metric = AbstractCube::Metric::HTM);
+	// The binary lookup file (see LookupFileHeader) of the table in the given metric
+	void writeToFile(const std::string& filename, AbstractCube::Metric metric) const;
+	// Maps the file read-only (see MappedFile), the table is then used in place
+	void readFromFile(const std::string& filename, AbstractCube::Metric metric);
+	// The "hash depth" text lines written by older versions
+	void readFromTextFile(const std::string& filename);
+
+	uint32_t size() const { return classCount; }
+	uint32_t classIndex(const Cube2Pieces& cube) const;
+	uint8_t distance(const Cube2Pieces& cube) const;
+
+private:
+	// Identifies the table in the lookup files. The payload is offsets, then orientations, then distances.
+	static constexpr uint8_t fileScheme = 4;
+	// The number of symmetry classes, the same in every metric. A table with fewer is missing some.
+	static constexpr uint32_t numClasses = 77802;
+
+	// Classes with representative permutation p have indices offsets[p] to offsets[p + 1] - 1
+	const uint32_t* offsets = nullptr;
+	const uint16_t* orientations = nullptr;
+	// Two distances per byte, the even class index in the low nibble
+	const uint8_t* distances = nullptr;
+	uint32_t classCount = 0;
+
+	// Where the arrays above are: in the mapped lookup file, or in these vectors when the table was built in memory
+	MappedFile file;
+	std::vector<uint32_t> offsetStorage;
+	std::vector<uint16_t> orientationStorage;
+	std::vector<uint8_t> distanceStorage;
+
+	// Build the index from (symmetry hash, distance) pairs
+	void build(const std::unordered_map<uint64_t, uint8_t>& classDistances);
+};
 
 class Heuristic
 {
 public:
-	static void initOrientationLookup();
-	static void initPermutationLookup();
-	static void initPerfectLookup();
+	static void initOrientationLookup(AbstractCube::Metric metric = AbstractCube::Metric::HTM);
+	static void initPermutationLookup(AbstractCube::Metric metric = AbstractCube::Metric::HTM);
+	static void initPerfectLookup(AbstractCube::Metric metric = AbstractCube::Metric::HTM);
+	static void initPerfectSymmetryLookup(AbstractCube::Metric metric = AbstractCube::Metric::HTM);
+
+	// The lookup file for the table with the given name in the given metric, e.g. "orientationLookupQTM.bin"
+	static std::string lookupFilename(const std::string& name, AbstractCube::Metric metric, const std::string& extension = ".bin");
 
 	virtual uint16_t heuristic(const Cube2Pieces& cube) const = 0;
 
 //protected:
-	static std::unordered_map<uint64_t, uint16_t> orientationLookup;
-	static std::unordered_map<uint64_t, uint16_t> permutationLookup;
-	static std::unordered_map<uint64_t, uint16_t> perfectLookup;
+	// Indexed by Cube2Pieces::orientationIndex, permutationIndex and stateIndex respectively.
+	// They point into the mapped lookup files, and are null until their init function has run.
+	static const uint8_t* orientationLookup;
+	static const uint8_t* permutationLookup;
+	static const uint8_t* perfectLookup;
+	static SymmetryClassTable perfectSymmetryLookup;
 
 private:
-	static void generateLookupTable(std::unordered_map<uint64_t, uint16_t>& lookup, uint32_t(Cube2Pieces::* hashFunction)() const);
-	// Overload for 64 bit hash
-	static void generateLookupTable(std::unordered_map<uint64_t, uint16_t>& lookup, uint64_t(Cube2Pieces::* hashFunction)() const);
-	static void writeLookupToFile(const std::unordered_map<uint64_t, uint16_t>& lookup, const std::string& filename);
-	static void readLookupFromFile(std::unordered_map<uint64_t, uint16_t>& lookup, const std::string& filename);
+	// Where an entry of a table lives. The entry of a state is at (state index / stride) % size (see
+	// Cube2Pieces::stateIndex), e.g. stride numOrientations for the permutation table.
+	// The text files stored the canonical key shifted right by hashShift (and masked) instead of the index.
+	struct Layout
+	{
+		uint8_t scheme; // Identifies the layout in the lookup files, see LookupFileHeader
+		uint32_t size;
+		uint32_t stride;
+		uint8_t hashShift;
+
+		uint32_t indexOf(uint32_t stateIndex) const { return (stateIndex / stride) % size; }
+	};
+	static const Layout orientationLayout, permutationLayout, perfectLayout;
+	static MappedFile orientationFile, permutationFile, perfectFile;
+
+	static constexpr uint8_t unknownDistance = 0xFF;
+
+	// BFS from the solved cube over the entries of the table. Runs on CubeBatch, a whole depth at a time.
+	static void generateLookupTable(uint8_t* lookup, const Layout& layout, AbstractCube::Metric metric);
+	// Map the binary file, after converting the text file or generating the table if there is no binary file yet
+	static const uint8_t* initLookup(MappedFile& file, const Layout& layout, const std::string& name, AbstractCube::Metric metric);
+	static void writeLookupToFile(const uint8_t* lookup, const Layout& layout, AbstractCube::Metric metric, const std::string& filename);
+	// Map the file and check it, returns its entries
+	static const uint8_t* readLookupFromFile(MappedFile& file, const Layout& layout, AbstractCube::Metric metric, const std::string& filename);
+	static void readLookupFromTextFile(uint8_t* lookup, const Layout& layout, const std::string& filename);
 
 };
 
@@ -73,3 +199,25 @@ public:
 	uint16_t heuristic(const Cube2Pieces& cube) const override;
 };
 
+// Same distances as PerfectHeuristic, looked up by symmetry class
+class PerfectSymmetryHeuristic : public Heuristic
+{
+public:
+	uint16_t heuristic(const Cube2Pieces& cube) const override;
+};
+
+/* ----------------------------------------------------------------------------
+ * Wraps another heuristic and returns the larger of its values for the cube
+ * and for the inverse of the cube. The inverse is exactly as far from solved
+ * as the cube, so this is still admissible, and the two lookups often see
+ * different projections of the same state. No new tables are needed.
+ * --------------------------------------------------------------------------
+*/
+class InverseMaxHeuristic : public Heuristic
+{
+public:
+	explicit InverseMaxHeuristic(const Heuristic& base) : base(base) {}
+	uint16_t heuristic(const Cube2Pieces& cube) const override;
+private:
+	const Heuristic& base;
+};
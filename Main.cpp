@@ -10,19 +10,21 @@
 #include <bitset>
 
 #include "Cube2Pieces.h"
+#include "CubeBatch.h"
 #include "Heuristic.h"
 #include "Solvers.h"
+#include "Benchmarks.h"
 #include "argparse.h"
 
 void initArgparse(int argc, char** argv, argparse::ArgumentParser& program) {
 
 	program.add_argument("mode")
 		.required()
-		.help("Operation mode: 'solve', 'benchmark', or 'heuristic'")
+		.help("Operation mode: 'solve', 'benchmark', 'heuristic', or 'microbench'")
 		.action([](const std::string& value) {
-			static const std::vector<std::string> choices = { "solve", "benchmark", "heuristic"};
+			static const std::vector<std::string> choices = { "solve", "benchmark", "heuristic", "microbench" };
 			if (std::find(choices.begin(), choices.end(), value) == choices.end()) {
-				throw std::runtime_error("mode must be 'solve', benchmark', or 'heuristic'");
+				throw std::runtime_error("mode must be 'solve', benchmark', 'heuristic', or 'microbench'");
 			}
 			return value;
 		});
@@ -31,35 +33,64 @@ void initArgparse(int argc, char** argv, argparse::ArgumentParser& program) {
 		.help("Scramble to solve. Must be a string of moves separated by spaces, enclosed in double quotes. Example: \"U D R2 L2 F2 B2\"")
 		.default_value(std::string(""));
 
+	program.add_argument("--facelets")
+		.help("State to solve, as an alternative to --scramble. Must be 24 sticker colors (W, B, R, Y, G, O) listed face by face in the order U, R, F, D, L, B. Example: \"WWWWBBBBRRRRYYYYGGGGOOOO\" is the solved cube")
+		.default_value(std::string(""));
+
 	program.add_argument("--solver")
 		.default_value(std::string("astardual"))
-		.help("Type of solver to use in solve mode. Options are 'bfs', 'astarperf', 'astardual', 'astarori', 'astarperm'. Default is 'astardual'.")
+		.help("Type of solver to use in solve mode. Options are 'bfs', 'astarperf', 'astardual', 'astarori', 'astarperm', 'idacoord', 'idafixed'. Default is 'astardual'.")
 		.action([](const std::string& value) {
-			static const std::vector<std::string> choices = { "astarperf", "astardual", "astarori", "astarperm", "bfs" };
+			static const std::vector<std::string> choices = { "astarperf", "astardual", "astarori", "astarperm", "bfs", "idacoord", "idafixed" };
 			if (std::find(choices.begin(), choices.end(), value) == choices.end()) {
 				throw std::runtime_error("Invalid solver type.");
 			}
 			return value;
 		});
 
+	program.add_argument("--metric")
+		.default_value(std::string("htm"))
+		.help("Turn metric the solution should be optimal in. Options are 'htm' (half-turn), 'qtm' (quarter-turn), 'axial'. Default is 'htm'.")
+		.action([](const std::string& value) {
+			if (!AbstractCube::parseMetric(value))
+				throw std::runtime_error("Invalid metric.");
+			return value;
+		});
+
+	program.add_argument("--inverse")
+		.help("In solve mode, make the A* heuristics also look up the inverse of each state and use the larger of the two values.")
+		.default_value(false)
+		.implicit_value(true);
+
 	program.add_argument("--num-scrambles")
 		.scan<'d', int>()
 		.default_value(-1)
 		.help("Number of scrambles to perform in benchmark mode.");
 
+	program.add_argument("--iterations")
+		.scan<'d', int>()
+		.default_value(10000)
+		.help("Number of iterations of each microbenchmark in microbench mode.");
+
 	program.parse_args(argc, argv);
 
 	std::string mode = program.get<std::string>("mode");
 	if (mode == "solve") {
 		std::string scramble = program.get<std::string>("scramble");
-		if (scramble.empty())
-			throw std::runtime_error("Scramble must be provided in solve mode.");
+		std::string facelets = program.get<std::string>("facelets");
+		if (scramble.empty() == facelets.empty())
+			throw std::runtime_error("Exactly one of a scramble or facelets must be provided in solve mode.");
 	}
 	else if (mode == "benchmark") {
 		int num_scrambles = program.get<int>("--num-scrambles");
 		if (num_scrambles < 1)
 			throw std::runtime_error("Number of scrambles must be greater than 0.");
 	}
+	else if (mode == "microbench") {
+		int iterations = program.get<int>("--iterations");
+		if (iterations < 1)
+			throw std::runtime_error("Number of iterations must be greater than 0.");
+	}
 }
 
 void generateScrambles(int scramble_length, int num_scrambles)
@@ -129,9 +160,9 @@ std::pair<double, int> analyzeSolve(Cube2Pieces& cube, Solver& solver)
 	return { elapsed_seconds.count(), tokens.size() };
 }
 
-void printData(const std::string& scramble, const Solver& s, const Cube2Pieces& cube, const std::pair<double, int> result)
+void printData(const std::string& input, const Solver& s, const Cube2Pieces& cube, const std::pair<double, int> result)
 {
-	std::cout << "Scramble: " << scramble << std::endl;
+	std::cout << input << std::endl;
 	std::cout << "Solution: " << s.getSolution() << std::endl;
 	std::cout << "Solution Length: " << result.second << " moves" << std::endl;
 	std::cout << "Time: " << std::fixed << std::setprecision(6) << result.first << " seconds" << std::endl;
@@ -146,60 +177,93 @@ int main(int argc, char** argv)
 		initArgparse(argc, argv, program);
 		std::string mode = program.get<std::string>("mode");
 
-		// Initialize heuristic lookup tables
-		Heuristic::initOrientationLookup();
-		Heuristic::initPermutationLookup();
+		// The microbenchmarks do not need any lookup tables
+		if (mode == "microbench")
+		{
+			MicroBenchmark::run(program.get<int>("--iterations"));
+			return 0;
+		}
+
+		// Initialize heuristic lookup tables for the chosen metric
+		AbstractCube::Metric metric = *AbstractCube::parseMetric(program.get<std::string>("--metric"));
+		Heuristic::initOrientationLookup(metric);
+		Heuristic::initPermutationLookup(metric);
 
 		PermutationHeuristic permutationHeuristic;
 		OrientationHeuristic orientationHeuristic;
 		PerfectHeuristic perfectHeuristic;
+		PerfectSymmetryHeuristic perfectSymmetryHeuristic;
 		DualHeuristic dualHeuristic;
+		InverseMaxHeuristic inverseOrientationHeuristic(orientationHeuristic);
+		InverseMaxHeuristic inversePermutationHeuristic(permutationHeuristic);
+		InverseMaxHeuristic inverseDualHeuristic(dualHeuristic);
 
 
 		if (mode == "solve")
 		{
 			std::string type = program.get<std::string>("--solver");
 			std::string scramble = program.get<std::string>("--scramble");
+			std::string facelets = program.get<std::string>("--facelets");
 
-			Cube2Pieces cube(scramble);
+			Cube2Pieces cube = facelets.empty() ? Cube2Pieces(scramble) : Cube2Pieces::fromFacelets(facelets);
+			std::string input = facelets.empty() ? "Scramble: " + scramble : "Facelets: " + facelets;
 			std::pair<double, int> result;
+			bool useInverse = program.get<bool>("--inverse");
+			auto pick = [useInverse](Heuristic& heuristic, Heuristic& inverseHeuristic) -> Heuristic& {
+				return useInverse ? inverseHeuristic : heuristic;
+			};
 
 			if (type == "astarperf")
 			{
-				// Don't load in the perfect heuristic lookup table until it's needed -- it's large
-				Heuristic::initPerfectLookup();
+				// Don't load in the perfect heuristic lookup table until it's needed. The symmetry class
+				// version is small, but it still takes a moment to generate on the first run.
+				Heuristic::initPerfectSymmetryLookup(metric);
 				std::cout << "Solving with A* using perfect heuristic..." << std::endl;
-				AStarSolver solver(cube, perfectHeuristic);
+				AStarSolver solver(cube, perfectSymmetryHeuristic, Cube2Pieces::solvedGoal, metric);
 				result = analyzeSolve(cube, solver);
-				printData(scramble, solver, cube, result);
+				printData(input, solver, cube, result);
 			}
 			else if (type == "astardual")
 			{
 				std::cout << "Solving with A* using dual heuristic..." << std::endl;
-				AStarSolver solver(cube, dualHeuristic);
+				AStarSolver solver(cube, pick(dualHeuristic, inverseDualHeuristic), Cube2Pieces::solvedGoal, metric);
 				result = analyzeSolve(cube, solver);
-				printData(scramble, solver, cube, result);
+				printData(input, solver, cube, result);
 			}
 			else if (type == "astarori")
 			{
 				std::cout << "Solving with A* using orientation heuristic..." << std::endl;
-				AStarSolver solver(cube, orientationHeuristic);
+				AStarSolver solver(cube, pick(orientationHeuristic, inverseOrientationHeuristic), Cube2Pieces::solvedGoal, metric);
 				result = analyzeSolve(cube, solver);
-				printData(scramble, solver, cube, result);
+				printData(input, solver, cube, result);
 			}
 			else if (type == "astarperm")
 			{
 				std::cout << "Solving with A* using permutation heuristic..." << std::endl;
-				AStarSolver solver(cube, permutationHeuristic);
+				AStarSolver solver(cube, pick(permutationHeuristic, inversePermutationHeuristic), Cube2Pieces::solvedGoal, metric);
 				result = analyzeSolve(cube, solver);
-				printData(scramble, solver, cube, result);
+				printData(input, solver, cube, result);
 			}
 			else if (type == "bfs")
 			{
 				std::cout << "Solving with BFS..." << std::endl;
-				BFSSolver solver(cube);
+				BFSSolver solver(cube, Cube2Pieces::solvedGoal, metric);
+				result = analyzeSolve(cube, solver);
+				printData(input, solver, cube, result);
+			}
+			else if (type == "idacoord")
+			{
+				std::cout << "Solving with IDA* on coordinates..." << std::endl;
+				CoordinateSolver solver(cube, metric);
 				result = analyzeSolve(cube, solver);
-				printData(scramble, solver, cube, result);
+				printData(input, solver, cube, result);
+			}
+			else if (type == "idafixed")
+			{
+				std::cout << "Solving with IDA* on fixed-corner moves using dual heuristic..." << std::endl;
+				FixedCornerSolver solver(cube, pick(dualHeuristic, inverseDualHeuristic), metric);
+				result = analyzeSolve(cube, solver);
+				printData(input, solver, cube, result);
 			}
 			else {
 				throw std::runtime_error("Invalid solver type.");
@@ -208,7 +272,7 @@ int main(int argc, char** argv)
 
 		else if (mode == "benchmark")
 		{
-			Heuristic::initPerfectLookup();
+			Heuristic::initPerfectSymmetryLookup(metric);
 			int num_scrambles = program.get<int>("--num-scrambles");
 			generateScrambles(15, num_scrambles);
 			std::vector<std::string> scrambles = readScramblesFromFile("scrambles_tested.txt");
@@ -224,16 +288,16 @@ int main(int argc, char** argv)
 			file << "Scramble,Length,Perf,Dual,Ori,Perm,BFS" << std::endl;
 			for (const std::string& scramble : scrambles)
 			{
-				Cube2Pieces cube1(scramble);
-				Cube2Pieces cube2(scramble);
-				Cube2Pieces cube3(scramble);
-				Cube2Pieces cube4(scramble);
-				Cube2Pieces cubebfs(scramble);
-				AStarSolver solver1(cube1, perfectHeuristic);
-				AStarSolver solver2(cube2, dualHeuristic);
-				AStarSolver solver3(cube3, orientationHeuristic);
-				AStarSolver solver4(cube4, permutationHeuristic);
-				BFSSolver solver5(cubebfs);
+				// Parse the scramble once and apply it to every solver's cube as a single transform
+				const Cube2Pieces::CompiledScramble compiled(scramble);
+				Cube2Pieces cube1, cube2, cube3, cube4, cubebfs;
+				for (Cube2Pieces* cube : { &cube1, &cube2, &cube3, &cube4, &cubebfs })
+					cube->applyScramble(compiled);
+				AStarSolver solver1(cube1, perfectSymmetryHeuristic, Cube2Pieces::solvedGoal, metric);
+				AStarSolver solver2(cube2, dualHeuristic, Cube2Pieces::solvedGoal, metric);
+				AStarSolver solver3(cube3, orientationHeuristic, Cube2Pieces::solvedGoal, metric);
+				AStarSolver solver4(cube4, permutationHeuristic, Cube2Pieces::solvedGoal, metric);
+				BFSSolver solver5(cubebfs, Cube2Pieces::solvedGoal, metric);
 
 				std::vector<std::pair<double, int>> results;
 				results.push_back(analyzeSolve(cube1, solver1));
@@ -251,7 +315,7 @@ int main(int argc, char** argv)
 
 		else if (mode == "heuristic")
 		{
-			Heuristic::initPerfectLookup();
+			Heuristic::initPerfectLookup(metric);
 			std::ofstream file = std::ofstream("heuristic_evaluation.txt", std::ofstream::out);
 			if (!file.is_open())
 			{
@@ -259,20 +323,37 @@ int main(int argc, char** argv)
 				return 1;
 			}
 
-			file << "Hash,Perfect,Orientation,Permutation,Dual" << std::endl;
-			for (const auto& pair : Heuristic::perfectLookup)
+			// The canonical key is the permutation bits OR the orientation bits (see Cube2Pieces::cubeHash), so the
+			// key of every state comes from the keys of one cube per permutation and one per orientation
+			CubeBatch permutationCubes, orientationCubes;
+			for (uint16_t p = 0; p < Cube2Pieces::numPermutations; p++)
+				permutationCubes.push(Cube2Pieces::fromCoordinates(p, 0));
+			for (uint16_t o = 0; o < Cube2Pieces::numOrientations; o++)
+				orientationCubes.push(Cube2Pieces::fromCoordinates(0, o));
+			std::vector<uint64_t> permutationKeys(permutationCubes.size()), orientationKeys(orientationCubes.size());
+			permutationCubes.hashes(permutationKeys.data());
+			orientationCubes.hashes(orientationKeys.data());
+
+			file << "Hash,Perfect,Orientation,Permutation,Dual" << '\n';
+			for (uint16_t p = 0; p < Cube2Pieces::numPermutations; p++)
 			{
-				const uint64_t mask_orientation = 0b1111111111111111000000000000000000000000;
-				uint64_t orientationHash = (pair.first & mask_orientation) >> 24;
-				uint64_t permutationHash = pair.first & ~mask_orientation;
-
-				// Put in order of hash, perfect, orientation, permutation, dual
-
-				file << pair.first << "," << pair.second << "," << Heuristic::orientationLookup[orientationHash] << "," << Heuristic::permutationLookup[permutationHash] << "," << std::max(Heuristic::orientationLookup[orientationHash], Heuristic::permutationLookup[permutationHash]) << std::endl;
+				uint16_t permutation = Heuristic::permutationLookup[p];
+				for (uint16_t o = 0; o < Cube2Pieces::numOrientations; o++)
+				{
+					uint16_t orientation = Heuristic::orientationLookup[o];
+					uint64_t hash = (permutationKeys[p] & 0xFFFFFF) | (orientationKeys[o] & ~0xFFFFFFULL);
+					uint32_t index = static_cast<uint32_t>(p) * Cube2Pieces::numOrientations + o;
+
+					// Put in order of hash, perfect, orientation, permutation, dual
+					file << hash << "," << static_cast<uint16_t>(Heuristic::perfectLookup[index]) << "," << orientation << "," << permutation << "," << std::max(orientation, permutation) << '\n';
+				}
 			}
 		}
 	}
 	catch (const std::runtime_error& err) {
 		std::cout << err.what() << std::endl;
 	}
+	catch (const std::invalid_argument& err) {
+		std::cout << err.what() << std::endl;
+	}
 }
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "ABCCube.h"
+
+/* ----------------------------------------------------------------------------
+ * Move pruning beyond the previous-move rules of AbstractCube::isMoveAllowed.
+ *
+ * A sequence of moves is redundant if another sequence has the same effect on
+ * every cube (up to a whole-cube rotation) and is shorter, or, for the Ordered
+ * kind, has the same length and comes first in the order the moves are tried.
+ * A path that contains a redundant sequence never needs to be searched: the
+ * other sequence gives a path to the same cube that is no longer.
+ *
+ * The automaton is built when it is first needed, by applying every sequence
+ * of up to `window` moves to the solved cube and comparing canonical keys.
+ * Its states stand for the last window - 1 moves of a path, and every state
+ * has a mask of the moves that may follow and the state after each of them.
+ * The searches carry the state of every node along with the cube.
+ *
+ * Which kind a search may use:
+ * - Ordered, for depth-first searches, which try every path that is not
+ *   pruned, and for BFS, which keeps the first path to every cube in the
+ *   order moves are tried, i.e. the one with no redundant sequence in it.
+ * - Shorter, for A*, which keeps whichever path to a cube it finds first and
+ *   so could lose every optimal path to a cube under the Ordered kind. A
+ *   sequence with a shorter equivalent is never part of a shortest path.
+ * --------------------------------------------------------------------------
+*/
+class MoveAutomaton
+{
+public:
+	using Move = AbstractCube::Move;
+	using Metric = AbstractCube::Metric;
+	using State = uint16_t;
+
+	enum class Redundancy : uint8_t { Shorter, Ordered };
+
+	// The state of a path with no moves yet
+	static constexpr State start = 0;
+
+	// Build the automaton for the given moves, tried in the given order
+	MoveAutomaton(const std::vector<Move>& moves, Redundancy redundancy, uint8_t window = 4);
+
+	// Bit n is set if the Move with underlying value n may be applied in the given state
+	uint32_t allowedMoves(State state) const { return allowed[state]; }
+	bool isMoveAllowed(State state, Move move) const { return allowed[state] & (1u << static_cast<uint8_t>(move)); }
+	// The state after an allowed move
+	State next(State state, Move move) const { return transitions[state][static_cast<uint8_t>(move)]; }
+
+	size_t numStates() const { return allowed.size(); }
+
+	// The automata for the move sets of the solvers: the moves of AbstractCube::searchOrder and
+	// Cube2Pieces::fixedCornerMoves that are single moves in the metric. Built on first use.
+	static const MoveAutomaton& forAllMoves(Metric metric, Redundancy redundancy);
+	static const MoveAutomaton& forFixedCornerMoves(Metric metric, Redundancy redundancy);
+
+private:
+	std::vector<uint32_t> allowed;
+	std::vector<std::array<State, 19>> transitions;
+};
@@ -4,6 +4,8 @@
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
+#include <array>
+#include <algorithm>
 
 #include "utils.h"
 #include "ABCCube.h"
@@ -11,40 +13,54 @@
 #include "Heuristic.h"
 #include "Solvers.h"
 
-void BFSSolver::solve()
+template <typename CubeType>
+void BFSSolver<CubeType>::solve()
 {
+	/*
+	 * When the goal is the solved cube, the visited set holds symmetry classes instead of states.
+	 * Cubes in the same class are the same distance from solved, so once one of them has been reached,
+	 * the others cannot lead to a shorter solution. The search tree itself is unchanged (every node
+	 * is still reached from its parent by a real move), so the path needs no mapping.
+	 * Other goals are not symmetric, so they fall back to the canonical key.
+	*/
 	solutionPath = "";
 	std::queue<std::shared_ptr<BFSNode>> frontier;
 	std::unordered_set<uint64_t> visited;
 
-	frontier.emplace(std::make_shared<BFSNode>(std::make_shared<Cube2Pieces>(startCube), nullptr, AbstractCube::Move::None));
-	visited.insert(startCube.cubeHash());
+	const bool useSymmetry = goal == CubeType::solvedGoal;
+	auto visitedKey = [useSymmetry](const CubeType& cube) { return useSymmetry ? cube.symmetryHash() : cube.cubeHash(); };
+
+	SuccessorBuffer<CubeType> successors;
+
+	frontier.emplace(std::make_shared<BFSNode>(cube, nullptr, AbstractCube::Move::None, MoveAutomaton::start));
+	visited.insert(visitedKey(cube));
 
 	while (!frontier.empty())
 	{
 		auto current = frontier.front();
-		if (current->cube->isSolved())
+		if (current->cube.isGoal(goal))
 		{
 			reconstructPath(current);
-			startCube.applyMoves(solutionPath);
+			cube.applyMoves(solutionPath);
 			return;
 		}
 		frontier.pop();
 
-		for (auto& nextCube : current->cube->getNextMoves())
+		current->cube.getSuccessors(successors, AbstractCube::allowedMoves(current->cube.getPrevMove(), metric) & automaton.allowedMoves(current->automatonState));
+		for (const auto& [nextCube, move] : successors)
 		{
-			uint64_t nextHash = static_cast<Cube2Pieces*>(nextCube.get())->cubeHash();
+			uint64_t nextHash = visitedKey(nextCube);
 			if (visited.find(nextHash) == visited.end())
 			{
-				auto nextNode = std::make_shared<BFSNode>(std::make_shared<Cube2Pieces>(*static_cast<Cube2Pieces*>(nextCube.get())), current, nextCube->getPrevMove());
 				visited.insert(nextHash);
-				frontier.emplace(std::move(nextNode));
+				frontier.emplace(std::make_shared<BFSNode>(nextCube, current, move, automaton.next(current->automatonState, move)));
 			}
 		}
 	}
 }
 
-void BFSSolver::reconstructPath(const std::shared_ptr<BFSNode>& endNode)
+template <typename CubeType>
+void BFSSolver<CubeType>::reconstructPath(const std::shared_ptr<BFSNode>& endNode)
 {
 	std::vector<AbstractCube::Move> moves;
 	auto current = endNode;
@@ -57,7 +73,8 @@ void BFSSolver::reconstructPath(const std::shared_ptr<BFSNode>& endNode)
 	solutionPath = AbstractCube::moveToString(moves);
 }
 
-void AStarSolver::solve()
+template <typename CubeType>
+void AStarSolver<CubeType>::solve()
 {
 	/*
 	 * openSet and nodeMap store essentially the same data, but we want to be able to do both
@@ -77,34 +94,38 @@ void AStarSolver::solve()
 	std::priority_queue<std::shared_ptr<AStarNode>, std::vector<std::shared_ptr<AStarNode>>, AStarNodeCompare> openSet;
 	std::unordered_map<uint64_t, std::pair<uint16_t, std::shared_ptr<AStarNode>>> nodeMap;
 
+	SuccessorBuffer<CubeType> successors;
+
 	// Initialize both openSet and nodeMap with the startCube
-	auto startNode = std::make_shared<AStarNode>(std::make_shared<Cube2Pieces>(startCube), nullptr, 0, heuristic.heuristic(startCube), AbstractCube::Move::None);
+	auto startNode = std::make_shared<AStarNode>(cube, nullptr, 0, heuristic.heuristic(cube), AbstractCube::Move::None, MoveAutomaton::start);
 	openSet.emplace(startNode);
-	nodeMap[startCube.cubeHash()] = { 0, startNode };
+	nodeMap[cube.cubeHash()] = { 0, startNode };
 
 	while (!openSet.empty())
 	{
 		auto current = openSet.top();
-		if (current->cube->isSolved()) // Cube is solved
+		if (current->cube.isGoal(goal)) // Cube is at the goal
 		{
-			reconstructPath(current, nodeMap);
-			startCube.applyMoves(solutionPath);
+			reconstructPath(current);
+			cube.applyMoves(solutionPath);
 			return;
 		}
 		openSet.pop();
 
-		if (current->gScore > nodeMap[current->cube->cubeHash()].first)
+		if (current->gScore > nodeMap[current->cube.cubeHash()].first)
 			continue;
 
-		for (auto& nextCube : current->cube->getNextMoves())
+		current->cube.getSuccessors(successors, AbstractCube::allowedMoves(current->cube.getPrevMove(), metric) & automaton.allowedMoves(current->automatonState));
+		for (const auto& [nextCube, move] : successors)
 		{
 			uint16_t candidate_gScore = current->gScore + 1;
-			uint64_t nextHash = static_cast<Cube2Pieces*>(nextCube.get())->cubeHash();
+			uint64_t nextHash = nextCube.cubeHash();
 
 			// Either we discovered a new node or we found a better path to an existing node
-			if (nodeMap.find(nextHash) == nodeMap.end() || candidate_gScore < nodeMap[nextHash].first)
+			auto it = nodeMap.find(nextHash);
+			if (it == nodeMap.end() || candidate_gScore < it->second.first)
 			{
-				auto nextNode = std::make_shared<AStarNode>(std::make_shared<Cube2Pieces>(*static_cast<Cube2Pieces*>(nextCube.get())), current, candidate_gScore, heuristic.heuristic(*static_cast<Cube2Pieces*>(nextCube.get())), nextCube->getPrevMove());
+				auto nextNode = std::make_shared<AStarNode>(nextCube, current, candidate_gScore, heuristic.heuristic(nextCube), move, automaton.next(current->automatonState, move));
 				nodeMap[nextHash] = { candidate_gScore, nextNode };
 				openSet.emplace(std::move(nextNode));
 			}
@@ -112,16 +133,157 @@ void AStarSolver::solve()
 	}
 }
 
-void AStarSolver::reconstructPath(const std::shared_ptr<AStarNode>& endNode, const std::unordered_map<uint64_t, std::pair<uint16_t, std::shared_ptr<AStarNode>>>& nodeMap)
+template <typename CubeType>
+void AStarSolver<CubeType>::reconstructPath(const std::shared_ptr<AStarNode>& endNode)
 {
+	// Every node keeps the parent it was generated from, so the chain is a valid path from the start
 	std::vector<AbstractCube::Move> moves;
 	auto current = endNode;
 	while (current && current->move != AbstractCube::Move::None)
 	{
 		moves.push_back(current->move);
-		auto it = nodeMap.find(static_cast<Cube2Pieces*>(current->cube.get())->cubeHash());
-		current = it != nodeMap.end() ? it->second.second->parent : nullptr;
+		current = current->parent;
 	}
 	std::reverse(moves.begin(), moves.end());  // Make sure the moves are in the correct order
 	solutionPath = AbstractCube::moveToString(moves);
 }
+
+// BFS over a single coordinate, starting from the solved coordinate 0, with the moves that are single moves in the metric
+template <size_t N>
+static std::array<uint8_t, N> buildCoordinateDistances(uint16_t(*coordinateMove)(uint16_t, AbstractCube::Move),
+	const std::array<AbstractCube::Move, 9>& moves, AbstractCube::Metric metric)
+{
+	const uint8_t unvisited = 0xFF;
+	std::array<uint8_t, N> res;
+	res.fill(unvisited);
+	res[0] = 0;
+
+	std::queue<uint16_t> frontier;
+	frontier.push(0);
+	while (!frontier.empty())
+	{
+		uint16_t current = frontier.front();
+		frontier.pop();
+		for (AbstractCube::Move move : moves)
+		{
+			if (!AbstractCube::isMoveAllowed(AbstractCube::Move::None, move, metric))
+				continue;
+			uint16_t next = coordinateMove(current, move);
+			if (res[next] == unvisited)
+			{
+				res[next] = res[current] + 1;
+				frontier.push(next);
+			}
+		}
+	}
+	return res;
+}
+
+// Axial distances are the HTM distances, so the axial metric uses the HTM tables
+const CoordinateSolver::PermutationDistances& CoordinateSolver::permutationDistancesFor(AbstractCube::Metric metric)
+{
+	if (metric == AbstractCube::Metric::QTM)
+	{
+		static const auto distances = buildCoordinateDistances<Cube2Pieces::numPermutations>(&Cube2Pieces::permutationMove, Cube2Pieces::fixedCornerMoves, metric);
+		return distances;
+	}
+	static const auto distances = buildCoordinateDistances<Cube2Pieces::numPermutations>(&Cube2Pieces::permutationMove, Cube2Pieces::fixedCornerMoves, AbstractCube::Metric::HTM);
+	return distances;
+}
+
+const CoordinateSolver::OrientationDistances& CoordinateSolver::orientationDistancesFor(AbstractCube::Metric metric)
+{
+	if (metric == AbstractCube::Metric::QTM)
+	{
+		static const auto distances = buildCoordinateDistances<Cube2Pieces::numOrientations>(&Cube2Pieces::orientationMove, Cube2Pieces::fixedCornerMoves, metric);
+		return distances;
+	}
+	static const auto distances = buildCoordinateDistances<Cube2Pieces::numOrientations>(&Cube2Pieces::orientationMove, Cube2Pieces::fixedCornerMoves, AbstractCube::Metric::HTM);
+	return distances;
+}
+
+void CoordinateSolver::solve()
+{
+	solutionPath = "";
+	uint16_t perm = cube.permutationIndex();
+	uint16_t ori = cube.orientationIndex();
+
+	// Raise the bound one move at a time; a 2x2x2 cube never needs more than 11 moves
+	std::vector<AbstractCube::Move> path;
+	uint8_t bound = std::max(permutationDistances[perm], orientationDistances[ori]);
+	while (!search(perm, ori, bound, MoveAutomaton::start, path))
+		bound++;
+
+	std::vector<AbstractCube::Move> moves;
+	for (AbstractCube::Move move : path)
+		moves.push_back(cube.fromNormalizedFrame(move));
+	solutionPath = AbstractCube::moveToString(moves);
+	cube.applyMoves(moves);
+}
+
+bool CoordinateSolver::search(uint16_t perm, uint16_t ori, uint8_t movesLeft, MoveAutomaton::State automatonState, std::vector<AbstractCube::Move>& path) const
+{
+	if (perm == 0 && ori == 0)
+		return true;
+	if (std::max(permutationDistances[perm], orientationDistances[ori]) > movesLeft)
+		return false;
+
+	for (AbstractCube::Move move : Cube2Pieces::fixedCornerMoves)
+	{
+		// The automaton subsumes the previous-move rules for these moves
+		if (!automaton.isMoveAllowed(automatonState, move))
+			continue;
+		path.push_back(move);
+		if (search(Cube2Pieces::permutationMove(perm, move), Cube2Pieces::orientationMove(ori, move), movesLeft - 1,
+			automaton.next(automatonState, move), path))
+			return true;
+		path.pop_back();
+	}
+	return false;
+}
+
+void FixedCornerSolver::solve()
+{
+	solutionPath = "";
+	Cube2Pieces node = cube;
+	node.normalize();
+	node.clearPrevMove();
+
+	std::vector<AbstractCube::Move> path;
+	uint8_t bound = static_cast<uint8_t>(heuristic.heuristic(node));
+	while (!search(node, bound, MoveAutomaton::start, path))
+		bound++;
+
+	std::vector<AbstractCube::Move> moves;
+	for (AbstractCube::Move move : path)
+		moves.push_back(cube.fromNormalizedFrame(move));
+	solutionPath = AbstractCube::moveToString(moves);
+	cube.applyMoves(moves);
+}
+
+bool FixedCornerSolver::search(Cube2Pieces& node, uint8_t movesLeft, MoveAutomaton::State automatonState, std::vector<AbstractCube::Move>& path) const
+{
+	if (node.isSolved())
+		return true;
+	// A heuristic may be 0 on an unsolved state (e.g. the orientation one), so the bound has to stop the search too
+	if (movesLeft == 0 || heuristic.heuristic(node) > movesLeft)
+		return false;
+
+	for (AbstractCube::Move move : Cube2Pieces::fixedCornerMoves)
+	{
+		// The automaton subsumes the previous-move rules for these moves
+		if (!automaton.isMoveAllowed(automatonState, move))
+			continue;
+		AbstractCube::Move prev = node.doMove(move);
+		path.push_back(move);
+		if (search(node, movesLeft - 1, automaton.next(automatonState, move), path))
+			return true;
+		path.pop_back();
+		node.undoMove(move, prev);
+	}
+	return false;
+}
+
+// Explicit instantiations for the cube types in use
+template class BFSSolver<Cube2Pieces>;
+template class AStarSolver<Cube2Pieces>;
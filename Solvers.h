@@ -5,23 +5,45 @@
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <array>
 
 #include "utils.h"
+#include "ABCCube.h"
 #include "Cube2Pieces.h"
 #include "Heuristic.h"
+#include "MoveAutomaton.h"
+
+/* ----------------------------------------------------------------------------
+ * The solvers are templated on the concrete cube type, so that they call the
+ * cube's moves, successor generation and hashing directly (see CubeEngine in
+ * ABCCube.h) instead of through the AbstractCube vtable. The Solver base class
+ * stays polymorphic so that callers can treat every solver alike.
+ *
+ * The template member functions are defined in Solvers.cpp and explicitly
+ * instantiated there for the cube types we use. The heuristics are defined on
+ * Cube2Pieces, so A* is only instantiated for Cube2Pieces.
+ *
+ * BFS and A* search for a CubeGoal (see ABCCube.h), the solved cube unless
+ * another goal is passed to the constructor. Every solver takes the turn
+ * metric the solution should be optimal in (HTM by default). The A* heuristic
+ * must come from the lookup tables of the same metric.
+ *
+ * Besides the previous-move rules, every solver prunes redundant move
+ * sequences with a MoveAutomaton, whose state is kept with every node.
+ * --------------------------------------------------------------------------
+*/
 
 class Solver
 {
 public:
 	enum class SolverType { BFS, ASTAR };
 
-	// Ensure that CubeType is a derivative of AbstractCube or a related interface
-	explicit Solver(Cube2Pieces& startCube) : startCube(startCube) { startCube.clearPrevMove(); }
+	explicit Solver(AbstractCube& startCube) : startCube(startCube) { startCube.clearPrevMove(); }
 	virtual void solve() = 0;
 	std::string getSolution() const
 	{
-		if (!startCube.isSolved())
-			throw std::runtime_error("Error: getSolution called on an unsolved cube.");
+		if (!goalReached())
+			throw std::runtime_error("Error: getSolution called on a cube that has not reached the goal.");
 		return solutionPath;
 	}
 
@@ -29,51 +51,77 @@ public:
 	Solver(const Solver&) = delete;
 	Solver& operator=(const Solver&) = delete;
 
+	virtual ~Solver() = default;
+
 protected:
-	Cube2Pieces& startCube;
+	AbstractCube& startCube;
 	std::string solutionPath = "";
+
+	// Whether the start cube is at the goal of the solver (solved, unless the solver supports other goals)
+	virtual bool goalReached() const { return startCube.isSolved(); }
 };
 
+template <typename CubeType>
 class BFSSolver : public Solver
 {
 public:
-	using Solver::Solver;
+	explicit BFSSolver(CubeType& startCube, CubeGoal goal = CubeType::solvedGoal, AbstractCube::Metric metric = AbstractCube::Metric::HTM)
+		: Solver(startCube), cube(startCube), goal(goal), metric(metric),
+		automaton(MoveAutomaton::forAllMoves(metric, MoveAutomaton::Redundancy::Ordered)) {}
 	void solve() override;
 protected:
+	CubeType& cube;
+	CubeGoal goal;
+	AbstractCube::Metric metric;
+	const MoveAutomaton& automaton;
+
+	bool goalReached() const override { return cube.isGoal(goal); }
+
 	struct BFSNode {
-		std::shared_ptr<Cube2Pieces> cube;
+		CubeType cube;
 		std::shared_ptr<BFSNode> parent;
 		AbstractCube::Move move;
+		MoveAutomaton::State automatonState;
 
-		BFSNode(std::shared_ptr<Cube2Pieces> cube, std::shared_ptr<BFSNode> parent, AbstractCube::Move move)
-			: cube(cube), parent(parent), move(move) {}
+		BFSNode(const CubeType& cube, std::shared_ptr<BFSNode> parent, AbstractCube::Move move, MoveAutomaton::State automatonState)
+			: cube(cube), parent(parent), move(move), automatonState(automatonState) {}
 	};
 
 	void reconstructPath(const std::shared_ptr<BFSNode>& endNode);
 };
 
+template <typename CubeType>
 class AStarSolver : public Solver
 {
 public:
-	explicit AStarSolver(Cube2Pieces& startCube, Heuristic& heuristic)
-		: Solver(startCube), heuristic(heuristic) {}
+	// The heuristic must be admissible for the goal for the solution to be optimal
+	explicit AStarSolver(CubeType& startCube, Heuristic& heuristic, CubeGoal goal = CubeType::solvedGoal, AbstractCube::Metric metric = AbstractCube::Metric::HTM)
+		: Solver(startCube), cube(startCube), heuristic(heuristic), goal(goal), metric(metric),
+		automaton(MoveAutomaton::forAllMoves(metric, MoveAutomaton::Redundancy::Shorter)) {}
 	void solve() override;
 private:
+	CubeType& cube;
 	Heuristic& heuristic;
+	CubeGoal goal;
+	AbstractCube::Metric metric;
+	const MoveAutomaton& automaton;
+
+	bool goalReached() const override { return cube.isGoal(goal); }
 
 	struct AStarNode : public std::enable_shared_from_this<AStarNode> {
-		std::shared_ptr<Cube2Pieces> cube;
+		CubeType cube;
 		std::shared_ptr<AStarNode> parent;
 		uint16_t gScore;
 		uint16_t fScore;
 		AbstractCube::Move move;
+		MoveAutomaton::State automatonState;
 
-		AStarNode(std::shared_ptr<Cube2Pieces> cube, std::shared_ptr<AStarNode> parent, uint16_t gScore, uint16_t hScore, AbstractCube::Move move)
-			: cube(cube), parent(parent), gScore(gScore), fScore(gScore + hScore), move(move) {}
+		AStarNode(const CubeType& cube, std::shared_ptr<AStarNode> parent, uint16_t gScore, uint16_t hScore, AbstractCube::Move move, MoveAutomaton::State automatonState)
+			: cube(cube), parent(parent), gScore(gScore), fScore(gScore + hScore), move(move), automatonState(automatonState) {}
 
 		bool operator>(const AStarNode& other) const { return fScore > other.fScore; }
 
-		std::shared_ptr<AStarNode> get_shared_this() { return shared_from_this(); }
+		std::shared_ptr<AStarNode> get_shared_this() { return this->shared_from_this(); }
 	};
 
 	// Required for the priority queue
@@ -83,5 +131,71 @@ private:
 		}
 	};
 
-	void reconstructPath(const std::shared_ptr<AStarNode>& endNode, const std::unordered_map<uint64_t, std::pair<uint16_t, std::shared_ptr<AStarNode>>>& nodeMap);
+	void reconstructPath(const std::shared_ptr<AStarNode>& endNode);
+};
+
+/* ----------------------------------------------------------------------------
+ * IDA* on the dense coordinates of Cube2Pieces. The search state is just the
+ * (permutation, orientation) pair of the normalized cube: a move is two loads
+ * from the coordinate transition tables and the heuristic is two more, so no
+ * cube objects are built inside the search.
+ *
+ * Only the 9 fixed-corner moves are searched (see Cube2Pieces::fixedCornerMoves),
+ * so the normalized cube never needs to be renormalized. The moves found are
+ * mapped back to the orientation of the start cube at the end.
+ *
+ * The heuristic is the larger of the exact permutation and orientation
+ * distances, which are computed once per metric by a BFS over the coordinates.
+ * In QTM the half turns are left out of the search and of the BFS.
+ * --------------------------------------------------------------------------
+*/
+class CoordinateSolver : public Solver
+{
+public:
+	explicit CoordinateSolver(Cube2Pieces& startCube, AbstractCube::Metric metric = AbstractCube::Metric::HTM)
+		: Solver(startCube), cube(startCube),
+		permutationDistances(permutationDistancesFor(metric)), orientationDistances(orientationDistancesFor(metric)),
+		automaton(MoveAutomaton::forFixedCornerMoves(metric, MoveAutomaton::Redundancy::Ordered)) {}
+	void solve() override;
+private:
+	Cube2Pieces& cube;
+
+	// Exact distance to solved of each permutation and each orientation coordinate
+	using PermutationDistances = std::array<uint8_t, Cube2Pieces::numPermutations>;
+	using OrientationDistances = std::array<uint8_t, Cube2Pieces::numOrientations>;
+	static const PermutationDistances& permutationDistancesFor(AbstractCube::Metric metric);
+	static const OrientationDistances& orientationDistancesFor(AbstractCube::Metric metric);
+	const PermutationDistances& permutationDistances;
+	const OrientationDistances& orientationDistances;
+	const MoveAutomaton& automaton;
+
+	// Depth-first search below the given node with the given number of moves left.
+	// The moves of a path that solves the cube are left in path.
+	bool search(uint16_t perm, uint16_t ori, uint8_t movesLeft, MoveAutomaton::State automatonState, std::vector<AbstractCube::Move>& path) const;
+};
+
+/* ----------------------------------------------------------------------------
+ * IDA* on a normalized Cube2Pieces with the 9 fixed-corner moves (see
+ * Cube2Pieces::fixedCornerMoves) and any of the heuristics. The whole search
+ * runs on a single cube object with doMove/undoMove, and since the cube stays
+ * normalized, hashing it for the goal test and the heuristic never rotates it.
+ * The moves found are mapped back to the orientation of the start cube.
+ * --------------------------------------------------------------------------
+*/
+class FixedCornerSolver : public Solver
+{
+public:
+	// The heuristic must be admissible for the metric for the solution to be optimal
+	explicit FixedCornerSolver(Cube2Pieces& startCube, Heuristic& heuristic, AbstractCube::Metric metric = AbstractCube::Metric::HTM)
+		: Solver(startCube), cube(startCube), heuristic(heuristic),
+		automaton(MoveAutomaton::forFixedCornerMoves(metric, MoveAutomaton::Redundancy::Ordered)) {}
+	void solve() override;
+private:
+	Cube2Pieces& cube;
+	Heuristic& heuristic;
+	const MoveAutomaton& automaton;
+
+	// Depth-first search below node with the given number of moves left. The node is restored before
+	// returning, unless a solution is found, in which case its moves are left in path.
+	bool search(Cube2Pieces& node, uint8_t movesLeft, MoveAutomaton::State automatonState, std::vector<AbstractCube::Move>& path) const;
 };
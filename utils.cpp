@@ -3,6 +3,19 @@
 #include <algorithm>
 #include <cstdint>
 #include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <iterator>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP
+#endif
 
 #include "utils.h"
 
@@ -26,3 +39,84 @@ std::vector<std::string> split(const std::string& s, char delimiter) {
 	}
 	return tokens;
 }
+
+std::string temporaryFilename(const std::string& filename)
+{
+#if defined(HAVE_MMAP)
+	// Process IDs are unique among the processes running at the same time
+	return filename + "." + std::to_string(getpid()) + ".tmp";
+#else
+	return filename + "." + std::to_string(std::random_device()()) + ".tmp";
+#endif
+}
+
+MappedFile::MappedFile(const std::string& filename)
+{
+#if defined(HAVE_MMAP)
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Error: MappedFile could not open the file: " + filename);
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Error: MappedFile could not read the size of the file: " + filename);
+	}
+	length = static_cast<size_t>(info.st_size);
+	// An empty file cannot be mapped, and there is nothing to map anyway
+	if (length > 0)
+	{
+		void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			close(fd);
+			throw std::runtime_error("Error: MappedFile could not map the file: " + filename);
+		}
+		mapped = static_cast<const uint8_t*>(address);
+	}
+	// The mapping keeps the file alive on its own
+	close(fd);
+#else
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Error: MappedFile could not open the file: " + filename);
+	buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	length = buffer.size();
+	mapped = buffer.data();
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		buffer = std::move(other.buffer);
+		mapped = other.mapped;
+		length = other.length;
+		other.mapped = nullptr;
+		other.length = 0;
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	release();
+}
+
+void MappedFile::release()
+{
+#if defined(HAVE_MMAP)
+	if (mapped != nullptr)
+		munmap(const_cast<uint8_t*>(mapped), length);
+#endif
+	buffer.clear();
+	mapped = nullptr;
+	length = 0;
+}
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 
 /* --------------------------------------------------------------------------------------------
@@ -23,3 +24,32 @@ std::string trimWhitespace(const std::string& str);
 // Splits a string into a vector of strings, using a delimiter.
 std::vector<std::string> split(const std::string& s, char delimiter);
 
+// A name in the same directory as filename that no other process running at the same time will pick,
+// for writing a file in full and then renaming it into place.
+std::string temporaryFilename(const std::string& filename);
+
+// A whole file mapped read-only into memory, for as long as the object lives. On POSIX systems this is
+// an mmap of the file, so nothing is copied or parsed, and every process mapping the same file shares
+// its pages through the page cache. Elsewhere the file is read into memory instead.
+// Throws std::runtime_error if the file cannot be opened or mapped.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& filename);
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	const uint8_t* data() const { return mapped; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t* mapped = nullptr;
+	size_t length = 0;
+	std::vector<uint8_t> buffer; // The contents when the file could not be mapped
+
+	void release();
+};